@@ -27,6 +27,7 @@
 #include <map>
 #include <set>
 #include <list>
+#include <functional>
 
 #include <CFGReader.h>
 #include <InputTokenizer.h>
@@ -59,14 +60,20 @@ public:
 	};
 
 	BFTraceReader(const std::string& filename);
+	BFTraceReader(std::istream* input);
 	virtual ~BFTraceReader();
 
 	virtual void loadCFGs();
 
+	// Parse the symbols, passing each one to handler as soon as its blocks
+	// and branches were read. The handler owns the symbol.
+	void readSymbols(const std::function<void(Symbol*)>& handler);
+
 private:
 	InputTokenizer m_tokens;
 	InputTokenizer::Lexeme m_current;
 
+	void buildCFGs(Symbol* sym);
 	void matchToken(InputTokenizer::Lexeme::Type type);
 
 };
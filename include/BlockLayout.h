@@ -0,0 +1,69 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#ifndef BLOCK_LAYOUT_H
+#define BLOCK_LAYOUT_H
+
+#include <vector>
+#include <string>
+
+#include <Addr.h>
+
+class CFG;
+
+// Profile-guided block order of a CFG. Blocks are first chained along
+// their heaviest fall-through edges (Pettis-Hansen), then the chains are
+// greedily concatenated while that improves the Ext-TSP score, which
+// also rewards short forward and backward jumps. The entry block comes
+// first, the remaining chains follow by decreasing execution density,
+// and never executed blocks are left at the end as cold.
+class BlockLayout {
+public:
+	BlockLayout(const CFG* cfg);
+	virtual ~BlockLayout();
+
+	const CFG* cfg() const { return m_cfg; }
+
+	// Executed blocks, in layout order.
+	const std::vector<Addr>& order() const { return m_order; }
+	// Never executed blocks, candidates for splitting.
+	const std::vector<Addr>& coldBlocks() const { return m_cold; }
+
+	// Ext-TSP score of the original (address) order and of the new one.
+	double originalScore() const { return m_originalScore; }
+	double score() const { return m_score; }
+
+	std::string str() const;
+
+private:
+	const CFG* m_cfg;
+	std::vector<Addr> m_order;
+	std::vector<Addr> m_cold;
+	double m_originalScore;
+	double m_score;
+
+	void compute();
+
+};
+
+#endif
@@ -33,6 +33,9 @@
 
 class CfgNode;
 class CfgEdge;
+class DominatorTree;
+class CFGHash;
+class HotSubgraph;
 
 class CFG {
 public:
@@ -52,6 +55,10 @@ public:
 
 	bool complete() const;
 
+	// Counts adjusted by FlowRepair to balance.
+	bool repaired() const { return m_repaired; }
+	void setRepaired(bool repaired = true) { m_repaired = repaired; }
+
 	CfgNode* entryNode() const { return m_entryNode; }
 	CfgNode* exitNode() const { return m_exitNode; }
 	CfgNode* haltNode() const { return m_haltNode; }
@@ -60,14 +67,34 @@ public:
 	const std::set<CfgNode*>& nodes() const { return m_nodes; }
 	bool containsNode(CfgNode* node) const;
 	void addNode(CfgNode* node);
+	// Removes and deletes the node with all its edges.
+	void removeNode(CfgNode* node);
+	// Turns a phantom node into a block of the given size. Phantoms are
+	// sinks of the post-dominator tree, so the cached trees are dropped.
+	void promotePhantom(CfgNode* node, int size = 0);
 
 	const std::set<CfgEdge*>& edges() const { return m_edges; }
 	CfgEdge* findEdge(CfgNode* src, CfgNode* dst) const;
 	void addEdge(CfgNode* src, CfgNode* dst, unsigned long long count = 0);
+	void removeEdge(CfgNode* src, CfgNode* dst);
 
 	const std::set<CfgNode*>& successors(CfgNode* node) const;
 	const std::set<CfgNode*>& predecessors(CfgNode* node) const;
 
+	// Executions of a node: the counts of the edges reaching it.
+	unsigned long long blockCount(CfgNode* node) const;
+
+	// Computed on first use and cached until a node or edge is added or
+	// removed, or a phantom is promoted.
+	const DominatorTree& dominatorTree() const;
+	const DominatorTree& postDominatorTree() const;
+	const CFGHash& hash() const;
+
+	// Drops the cached trees and hash. Changes made in place to the
+	// instructions, calls or indirect flag of a block are not seen by the
+	// CFG, so whoever makes them after loading must call it.
+	void invalidate();
+
 	unsigned long long execs() const { return m_execs; }
 	void setExecs(unsigned long long execs) { m_execs = execs; }
 	void updateExecs(unsigned long long execs) { m_execs += execs; }
@@ -75,8 +102,20 @@ public:
 	enum Status status() const { return m_status; }
 	enum CFG::Status check();
 
-	std::string toDOT() const;
-	void dumpDOT(const std::string& fileName);
+	// The flow rules of check(), shared with the streaming readers that
+	// validate functions without building their CFGs. A block must be
+	// reached and must leave, with as much flowing in as out; a phantom
+	// (an undefined block) is reached by edges that never execute.
+	static bool validBlock(bool defined, bool reached, bool leaves,
+					unsigned long long inflow, unsigned long long outflow);
+	// The entry edge carries the executions, and as many leave through
+	// the exit and halt edges.
+	static bool validFlow(unsigned long long entryCount,
+					unsigned long long exitCount, unsigned long long execs);
+
+	// With a hot subgraph, its cold regions are collapsed.
+	std::string toDOT(const HotSubgraph* hot = 0) const;
+	void dumpDOT(const std::string& fileName, const HotSubgraph* hot = 0);
 
 	std::string str() const;
 	friend std::ostream& operator<<(std::ostream& os, const CFG& cfg);
@@ -86,6 +125,7 @@ private:
 	enum Status m_status;
 	std::string m_functionName;
 	bool m_complete;
+	bool m_repaired;
 	unsigned long long m_execs;
 
 	CfgNode* m_entryNode;
@@ -95,9 +135,14 @@ private:
 	std::map<Addr, CfgNode*> m_nodesMap;
 
 	std::set<CfgEdge*> m_edges;
+	std::map<std::pair<CfgNode*, CfgNode*>, CfgEdge*> m_edgesMap;
 	std::map<CfgNode*, std::set<CfgNode*>> m_succs;
 	std::map<CfgNode*, std::set<CfgNode*>> m_preds;
 
+	mutable DominatorTree* m_domTree;
+	mutable DominatorTree* m_postDomTree;
+	mutable CFGHash* m_hash;
+
 };
 
 #endif
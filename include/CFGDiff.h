@@ -0,0 +1,91 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#ifndef CFG_DIFF_H
+#define CFG_DIFF_H
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <functional>
+
+#include <Addr.h>
+#include <CfgNode.h>
+
+class CFG;
+class CFGReader;
+
+// Compares the profiles of two runs of the same binary. CFGs are joined
+// by address, and edges by their source and destination blocks.
+class CFGDiff {
+public:
+	// A node is identified by its type and block address.
+	typedef std::pair<CfgNode::Type, Addr> NodeKey;
+
+	struct Change {
+		enum Kind {
+			FUNCTION,
+			BLOCK,
+			EDGE,
+			CALL
+		} kind;
+
+		Addr faddr;
+		std::string name;
+
+		// Block and edge source, or calling block.
+		NodeKey src;
+		// Edge destination, or called function.
+		NodeKey dst;
+
+		bool inBefore;
+		bool inAfter;
+		unsigned long long before;
+		unsigned long long after;
+
+		unsigned long long impact() const {
+			return (after > before ? after - before : before - after);
+		}
+	};
+
+	CFGDiff(unsigned jobs = 1);
+	virtual ~CFGDiff();
+
+	// Changes from before to after, sorted by decreasing impact.
+	void compare(const CFGReader& before, const CFGReader& after,
+		const std::function<bool(Addr)>& filter = 0);
+	const std::vector<Change>& changes() const { return m_changes; }
+
+	std::string str() const;
+	friend std::ostream& operator<<(std::ostream& os, const CFGDiff& diff);
+
+private:
+	unsigned m_jobs;
+	std::vector<Change> m_changes;
+
+	static void compareCFGs(const CFG* before, const CFG* after,
+		std::vector<Change>& changes);
+
+};
+
+#endif
@@ -0,0 +1,84 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#ifndef CFGGRIND_MERGER_H
+#define CFGGRIND_MERGER_H
+
+#include <list>
+#include <queue>
+#include <vector>
+#include <string>
+#include <ostream>
+#include <functional>
+
+#include <CFGGrindStream.h>
+
+// K-way merge of cfggrind files sorted by function address. Only the
+// records of the current function are kept in memory for each input.
+// Unsorted files are first split into sorted runs on disk.
+class CFGGrindMerger {
+public:
+	// Records of a function tagged with the index of their input.
+	typedef std::list<std::pair<unsigned, CFGGrindStream::Record>> Group;
+
+	CFGGrindMerger(const std::list<std::string>& inputs);
+	virtual ~CFGGrindMerger();
+
+	// All the records of the next function, in input order.
+	bool nextGroup(Group& group);
+	bool nextFunction(CFGGrindStream::Function& function);
+
+	// Merge inputs into output, limiting the number of files opened at once.
+	static void merge(const std::list<std::string>& inputs, std::ostream& output,
+		const std::string& tmpdir, const std::function<bool(Addr)>& filter = 0);
+
+	// Split the input in runs sorted by function address, each one
+	// holding at most budget bytes of records. With refs, a reference
+	// record is added for each called function and signal handler, so
+	// that functions only referenced are kept in address order too.
+	static std::list<std::string> sortRuns(const std::string& input,
+		unsigned long long budget, const std::string& tmpdir, bool refs = false);
+
+	// Estimated memory used by a record.
+	static unsigned long long recordSize(const CFGGrindStream::Record& record);
+
+	static std::string tempFile(const std::string& tmpdir);
+	static void removeFiles(const std::list<std::string>& files);
+
+	static const unsigned MAX_FANIN = 256;
+
+private:
+	struct Input {
+		CFGGrindStream* stream;
+		CFGGrindStream::Record record;
+	};
+
+	typedef std::pair<Addr, std::vector<Input>::size_type> HeapEntry;
+
+	std::vector<Input> m_inputs;
+	std::priority_queue<HeapEntry, std::vector<HeapEntry>,
+		std::greater<HeapEntry>> m_heap;
+
+};
+
+#endif
@@ -30,6 +30,7 @@
 class CFGGrindReader : public CFGReader {
 public:
 	CFGGrindReader(const std::string& filename);
+	CFGGrindReader(std::istream* input);
 	virtual ~CFGGrindReader();
 
 	virtual void loadCFGs();
@@ -0,0 +1,112 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#ifndef CFGGRIND_STREAM_H
+#define CFGGRIND_STREAM_H
+
+#include <map>
+#include <list>
+#include <vector>
+#include <string>
+#include <fstream>
+
+#include <Addr.h>
+#include <InputTokenizer.h>
+
+// Reads and writes cfggrind records one at a time, without building
+// the CFGs, so profiles larger than memory can be processed.
+class CFGGrindStream {
+public:
+	struct Node {
+		Addr addr;
+		int size;
+		std::vector<int> instrs;
+		std::map<Addr, unsigned long long> calls;
+		std::map<int, std::pair<Addr, unsigned long long>> signalHandlers;
+		bool indirect;
+		std::map<Addr, unsigned long long> succs;
+		bool exit;
+		unsigned long long exitCount;
+		bool halt;
+		unsigned long long haltCount;
+	};
+
+	struct Record {
+		enum Type {
+			CFG_RECORD,
+			NODE_RECORD,
+			// Reference to a called function or signal handler,
+			// only found in temporary files.
+			REF_RECORD
+		} type;
+
+		// Address of the function the record belongs to.
+		Addr faddr;
+
+		// CFG record.
+		unsigned long long execs;
+		std::string name;
+		bool complete;
+		// Counts adjusted by FlowRepair.
+		bool repaired;
+
+		// Node record.
+		Node node;
+	};
+
+	// All the records of a function, combined.
+	struct Function {
+		Addr addr;
+		unsigned long long execs;
+		std::string name;
+		bool repaired;
+		std::map<Addr, Node> nodes;
+	};
+
+	CFGGrindStream(const std::string& filename);
+	virtual ~CFGGrindStream();
+
+	const std::string& filename() const { return m_filename; }
+
+	bool nextRecord(Record& record);
+
+	static void write(std::ostream& os, const Record& record);
+	static void write(std::ostream& os, const Function& function);
+
+	static void clear(Function& function, Addr addr);
+	static void combine(Function& function, const Record& record);
+
+private:
+	std::string m_filename;
+	std::fstream m_input;
+	InputTokenizer m_tokens;
+	InputTokenizer::Lexeme m_current;
+
+	void readCfg(Record& record);
+	void readNode(Record& record);
+	unsigned long long readCount();
+	void matchToken(InputTokenizer::Lexeme::Type type);
+
+};
+
+#endif
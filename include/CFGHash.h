@@ -0,0 +1,73 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#ifndef CFG_HASH_H
+#define CFG_HASH_H
+
+#include <vector>
+#include <string>
+
+#include <Addr.h>
+
+class CFG;
+
+// Address-independent structural hashes of a CFG and its blocks, so the
+// same code can be recognized after a rebuild shifts it. The opcode hash
+// of a block covers its instruction sizes and, when the text is known,
+// their mnemonics; the shape hash adds the kinds of its successors
+// (fall-through or not), its call targets by name and whether it ends
+// indirectly. The CFG hash combines, in address order, the shapes of
+// the blocks without their call targets, so it still matches when the
+// callees are renamed. It only depends on the CFG's own blocks, so each
+// CFG can be hashed independently of the others, and the CFG caches its
+// hash until it changes (see CFG::hash()).
+class CFGHash {
+public:
+	typedef unsigned long long Hash;
+
+	struct Block {
+		Addr addr;
+		Hash opcodes;
+		Hash shape;
+	};
+
+	CFGHash(const CFG* cfg);
+	virtual ~CFGHash();
+
+	const CFG* cfg() const { return m_cfg; }
+	Hash hash() const { return m_hash; }
+
+	// In address order.
+	const std::vector<Block>& blocks() const { return m_blocks; }
+
+	static Hash hash(const std::string& str);
+	static Hash combine(Hash seed, Hash value);
+
+private:
+	const CFG* m_cfg;
+	Hash m_hash;
+	std::vector<Block> m_blocks;
+
+};
+
+#endif
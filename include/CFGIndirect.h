@@ -0,0 +1,84 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#ifndef CFG_INDIRECT_H
+#define CFG_INDIRECT_H
+
+#include <list>
+#include <vector>
+#include <string>
+
+#include <Addr.h>
+
+class CFG;
+
+// Target histograms of the indirect blocks, to drive indirect-call
+// promotion and devirtualization. An indirect block with calls is an
+// indirect call and its targets are the called functions; otherwise it
+// is an indirect jump and its targets are the successor blocks. Blocks
+// are ranked program-wide by the executions that promoting their top
+// targets would turn into direct transfers.
+class CFGIndirect {
+public:
+	struct Target {
+		Addr addr;
+		std::string name;
+		unsigned long long count;
+		double fraction;
+	};
+
+	struct Entry {
+		CFG* cfg;
+		Addr addr;
+		bool call;
+		unsigned long long count;
+		// By decreasing count.
+		std::vector<Target> targets;
+		// In bits; 0 for a monomorphic site.
+		double entropy;
+		// Fraction of the count reached by the top targets.
+		double coverage;
+		// Executions reached by the top targets.
+		unsigned long long profit;
+	};
+
+	// Consider the promotion of the top promotions targets of each block.
+	CFGIndirect(unsigned promotions = 2, unsigned jobs = 1);
+	virtual ~CFGIndirect();
+
+	// Collect the executed indirect blocks of each CFG in parallel and
+	// keep the limit most profitable ones (all of them if limit is 0).
+	void rank(const std::list<CFG*>& cfgs, unsigned limit = 0);
+	const std::vector<Entry>& entries() const { return m_entries; }
+
+	std::string str() const;
+	std::string toJSON() const;
+
+private:
+	unsigned m_promotions;
+	unsigned m_jobs;
+	std::vector<Entry> m_entries;
+
+};
+
+#endif
@@ -0,0 +1,60 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#ifndef CFG_INSTR_COUNTS_H
+#define CFG_INSTR_COUNTS_H
+
+#include <map>
+#include <string>
+
+#include <Addr.h>
+
+class CFG;
+
+// Dynamic instruction counts: each instruction of a block is executed
+// as many times as the block, i.e. the sum of its incoming edge counts.
+class CFGInstrCounts {
+public:
+	CFGInstrCounts();
+	virtual ~CFGInstrCounts();
+
+	void add(CFG* cfg);
+
+	const std::map<Addr, unsigned long long>& instructions() const { return m_instrs; }
+	const std::map<std::string, unsigned long long>& mnemonics() const { return m_mnemonics; }
+	unsigned long long total() const { return m_total; }
+
+	// Mnemonic of an instruction text, including its prefixes.
+	static std::string mnemonic(const std::string& text);
+
+	std::string str() const;
+	std::string toJSON() const;
+
+private:
+	std::map<Addr, unsigned long long> m_instrs;
+	std::map<std::string, unsigned long long> m_mnemonics;
+	unsigned long long m_total;
+
+};
+
+#endif
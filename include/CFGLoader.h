@@ -0,0 +1,87 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+#ifndef CFG_LOADER_H
+#define CFG_LOADER_H
+
+#include <list>
+#include <string>
+#include <iosfwd>
+#include <cstddef>
+
+class CFGReader;
+
+// Entry point for the programs that embed the cfg library: creates the
+// reader for a format and loads its CFGs from a file or from a memory
+// buffer. The returned reader owns the CFGs, which are walked with
+// CFGReader::cfgs() and queried through the CFG, CfgNode and CfgEdge
+// classes. The instructions are shared by all the readers of the process
+// (see Instruction::clear()). Malformed inputs are reported by throwing
+// a std::string, as everywhere else in the library.
+class CFGLoader {
+public:
+	enum Format {
+		UNDEF_FORMAT,
+		BFTRACE_FORMAT,
+		CFGGRIND_FORMAT,
+		DCFG_FORMAT
+	};
+
+	// The DCFG settings are ignored by the other formats.
+	struct Options {
+		Options() : jobs(1), routines(false) {}
+
+		unsigned jobs;
+		// One CFG per routine, built in parallel.
+		bool routines;
+		// Processes and images (full path or file name) to convert;
+		// all of them when empty.
+		std::list<long> processes;
+		std::list<std::string> images;
+	};
+
+	// Format by name ("bftrace", "cfggrind" or "dcfg"), case insensitive.
+	static Format format(const std::string& name);
+
+	// The caller must delete the returned reader.
+	static CFGReader* fromFile(Format format, const std::string& filename,
+					const Options& options = Options());
+	static CFGReader* fromBuffer(Format format, const std::string& buffer,
+					const Options& options = Options());
+	static CFGReader* fromBuffer(Format format, const char* data,
+					size_t size, const Options& options = Options());
+
+	// Reader of a file not loaded yet, so that several can be loaded in
+	// parallel with load(). The caller must delete it.
+	static CFGReader* create(Format format, const std::string& filename,
+					const Options& options = Options());
+	static void load(CFGReader* reader);
+
+private:
+	static CFGReader* create(Format format, std::istream* input,
+					const Options& options);
+	// Loads reader, deleting it if that fails.
+	static CFGReader* loaded(CFGReader* reader);
+
+};
+
+#endif
@@ -0,0 +1,68 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#ifndef CFG_LOOPS_H
+#define CFG_LOOPS_H
+
+#include <list>
+#include <vector>
+#include <string>
+
+#include <Addr.h>
+
+class CFG;
+
+// Program-wide ranking of the loops of all CFGs by dynamic weight.
+class CFGLoops {
+public:
+	struct Entry {
+		CFG* cfg;
+		Addr headerAddr;
+		std::string header;
+		unsigned depth;
+		bool reducible;
+		unsigned long long size;
+		unsigned long long entries;
+		unsigned long long backEdges;
+		double tripCount;
+		unsigned long long weight;
+	};
+
+	CFGLoops(unsigned jobs = 1);
+	virtual ~CFGLoops();
+
+	// Find the loops of each CFG in parallel and keep the limit
+	// heaviest ones (all of them if limit is 0).
+	void rank(const std::list<CFG*>& cfgs, unsigned limit = 0);
+	const std::vector<Entry>& entries() const { return m_entries; }
+
+	std::string str() const;
+	std::string toJSON() const;
+
+private:
+	unsigned m_jobs;
+	std::vector<Entry> m_entries;
+
+};
+
+#endif
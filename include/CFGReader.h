@@ -26,8 +26,10 @@
 
 #include <map>
 #include <set>
+#include <list>
+#include <mutex>
 #include <string>
-#include <fstream>
+#include <istream>
 
 #include <Addr.h>
 
@@ -40,16 +42,36 @@ public:
 
 	virtual void loadCFGs() = 0;
 
-	std::set<CFG*> cfgs() const;
+	std::list<CFG*> cfgs() const;
 	CFG* cfg(Addr addr) const;
 
 	CFG* instance(Addr addr);
 
+	// Add the CFGs and counts of other into this reader, then check
+	// the merged CFGs with checkCFGs().
+	void merge(const CFGReader& other);
+	void checkCFGs();
+
+	unsigned jobs() const { return m_jobs; }
+	void setJobs(unsigned jobs) { m_jobs = jobs; }
+
+	bool reportMemory() const { return m_reportMemory; }
+	void setReportMemory(bool reportMemory = true) { m_reportMemory = reportMemory; }
+
 protected:
 	CFGReader(const std::string& filename);
+	// Read from input instead of a file; the reader takes ownership of it.
+	CFGReader(std::istream* input);
 
-	std::fstream m_input;
+	std::istream* m_stream;
+	std::istream& m_input;
 	std::map<Addr, CFG*> m_cfgs;
+	mutable std::mutex m_cfgsMutex;
+	unsigned m_jobs;
+	bool m_reportMemory;
+
+	void startPhases() const;
+	void endPhase(const std::string& phase) const;
 
 	static CfgNode* entryNode(CFG* cfg);
 	static CfgNode* nodeWithAddr(CFG* cfg, Addr addr);
@@ -0,0 +1,102 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#ifndef CFG_STATS_H
+#define CFG_STATS_H
+
+#include <map>
+#include <string>
+#include <ostream>
+#include <unordered_map>
+
+#include <Addr.h>
+#include <BFTraceReader.h>
+
+class CFG;
+
+// Aggregate counts of a profile. The cfggrind and bftrace inputs are
+// read in a single pass without building the CFGs: only the flow of
+// each block is accumulated, which is enough to tell valid CFGs apart.
+class CFGStats {
+public:
+	CFGStats();
+	virtual ~CFGStats();
+
+	unsigned long long functions() const { return m_functions; }
+	unsigned long long valid() const { return m_valid; }
+	unsigned long long invalid() const { return m_functions - m_valid; }
+	unsigned long long blocks() const { return m_blocks; }
+	unsigned long long phantoms() const { return m_phantoms; }
+	unsigned long long edges() const { return m_edges; }
+	unsigned long long indirect() const { return m_indirect; }
+	unsigned long long execs() const { return m_execs; }
+
+	void loadCFGGrind(const std::string& filename);
+	void loadBFTrace(const std::string& filename);
+
+	// Account an already built and checked CFG.
+	void add(const CFG* cfg);
+
+	std::string str() const;
+	friend std::ostream& operator<<(std::ostream& os, const CFGStats& stats);
+
+private:
+	struct BlockFlow {
+		unsigned long long inflow;
+		unsigned long long outflow;
+		bool defined;
+		bool reached;
+		bool leaves;
+
+		BlockFlow() : inflow(0), outflow(0), defined(false), reached(false),
+			leaves(false) {}
+	};
+
+	struct FunctionFlow {
+		unsigned long long execs;
+		unsigned long long entryCount;
+		unsigned long long exitCount;
+		unsigned long long edges;
+		unsigned long long indirect;
+		bool hasEntry;
+		bool hasExit;
+		std::unordered_map<Addr, BlockFlow> blocks;
+
+		FunctionFlow() : execs(0), entryCount(0), exitCount(0), edges(0),
+			indirect(0), hasEntry(false), hasExit(false) {}
+	};
+
+	unsigned long long m_functions;
+	unsigned long long m_valid;
+	unsigned long long m_blocks;
+	unsigned long long m_phantoms;
+	unsigned long long m_edges;
+	unsigned long long m_indirect;
+	unsigned long long m_execs;
+
+	void addSymbol(const BFTraceReader::Symbol& sym);
+	void addFunction(const FunctionFlow& function);
+
+};
+
+#endif
@@ -0,0 +1,79 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#ifndef CFG_TOP_H
+#define CFG_TOP_H
+
+#include <queue>
+#include <vector>
+#include <string>
+
+#include <Addr.h>
+
+class CFG;
+
+// The K hottest functions, blocks and call sites, selected with bounded
+// heaps while the CFGs are added, so only K entries of each are kept.
+class CFGTop {
+public:
+	struct Entry {
+		CFG* cfg;
+		// Block or calling block address.
+		Addr addr;
+		CFG* called;
+		unsigned long long count;
+	};
+
+	CFGTop(unsigned k);
+	virtual ~CFGTop();
+
+	unsigned k() const { return m_k; }
+
+	void add(CFG* cfg);
+
+	// Sorted by decreasing count.
+	std::vector<Entry> functions() const;
+	std::vector<Entry> blocks() const;
+	std::vector<Entry> calls() const;
+
+	std::string str() const;
+	std::string toJSON() const;
+
+private:
+	struct Hotter {
+		bool operator()(const Entry& e1, const Entry& e2) const;
+	};
+
+	typedef std::priority_queue<Entry, std::vector<Entry>, Hotter> Heap;
+
+	unsigned m_k;
+	Heap m_functions;
+	Heap m_blocks;
+	Heap m_calls;
+
+	void push(Heap& heap, const Entry& entry);
+	static std::vector<Entry> sorted(Heap heap);
+
+};
+
+#endif
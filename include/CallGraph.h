@@ -0,0 +1,104 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#ifndef CALL_GRAPH_H
+#define CALL_GRAPH_H
+
+#include <map>
+#include <list>
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+#include <Addr.h>
+
+class CFG;
+
+// Interprocedural call graph built from the calls and signal handlers
+// of the blocks. Recursion is condensed in strongly connected components
+// (Tarjan), and the execution counts are propagated bottom-up over the
+// condensation: a caller is charged the share of the callee's inclusive
+// cost given by its share of the callee's incoming calls.
+class CallGraph {
+public:
+	struct Call {
+		unsigned caller;
+		unsigned callee;
+		// Calling block.
+		Addr site;
+		unsigned long long count;
+		bool signal;
+	};
+
+	struct BlockCost {
+		Addr addr;
+		unsigned long long blocks;
+		unsigned long long instrs;
+	};
+
+	struct Function {
+		CFG* cfg;
+		std::vector<BlockCost> costs;
+		// Exclusive block and instruction executions.
+		unsigned long long blocks;
+		unsigned long long instrs;
+		// Inclusive counts; shared by all the functions of a recursive component.
+		double inclusiveBlocks;
+		double inclusiveInstrs;
+		unsigned scc;
+	};
+
+	CallGraph(const std::list<CFG*>& cfgs, unsigned jobs = 1);
+	virtual ~CallGraph();
+
+	const std::vector<Function>& functions() const { return m_functions; }
+	const std::vector<Call>& calls() const { return m_calls; }
+
+	// Components in reverse topological order: callees come first.
+	const std::vector<std::vector<unsigned>>& sccs() const { return m_sccs; }
+	bool recursive(unsigned scc) const;
+
+	std::string str() const;
+	std::string toDOT() const;
+	std::string toCallgrind() const;
+
+private:
+	std::vector<Function> m_functions;
+	std::vector<Call> m_calls;
+	std::unordered_map<CFG*, unsigned> m_index;
+	std::vector<std::vector<unsigned>> m_sccs;
+	std::vector<bool> m_selfCalls;
+	// Calls entering each component from the others.
+	std::vector<unsigned long long> m_sccCalls;
+
+	unsigned functionIndex(CFG* cfg);
+	void build(const std::list<CFG*>& cfgs, unsigned jobs);
+	void condense();
+	void propagate();
+
+	// Share of the callee's inclusive cost charged to a call.
+	double share(const Call& call) const;
+
+};
+
+#endif
@@ -26,6 +26,7 @@
 
 #include <set>
 #include <list>
+#include <string>
 #include <Instruction.h>
 
 class CFG;
@@ -139,6 +140,10 @@ public:
 	void setData(Data* data);
 
 	static Addr node2addr(CfgNode* node);
+	static std::string node2name(CfgNode* node);
+
+	// Order nodes by address, with the special nodes last.
+	static bool nodeOrder(CfgNode* n1, CfgNode* n2);
 
 private:
 	enum CfgNode::Type m_type;
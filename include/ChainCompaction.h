@@ -0,0 +1,105 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#ifndef CHAIN_COMPACTION_H
+#define CHAIN_COMPACTION_H
+
+#include <map>
+#include <vector>
+#include <string>
+#include <iosfwd>
+
+#include <Addr.h>
+
+class CFG;
+class CFGReader;
+
+// Merges the chains of contiguous blocks where each block falls through
+// to its single successor, and that successor has no other predecessor,
+// into superblocks: typically blocks split by calls. A superblock keeps
+// the total size, the instructions and the calls of its members, the
+// counts of the edges into the first member and out of the last one.
+// Whatever merging loses is kept, so the CFG can be expanded back.
+class ChainCompaction {
+public:
+	struct Call {
+		CFG* called;
+		unsigned long long count;
+	};
+
+	struct SignalHandler {
+		int sigid;
+		CFG* handler;
+		unsigned long long count;
+	};
+
+	struct Member {
+		Addr addr;
+		int size;
+		bool indirect;
+		std::vector<Call> calls;
+		std::vector<SignalHandler> signalHandlers;
+	};
+
+	struct Chain {
+		std::vector<Member> members;
+		// Counts of the edges between consecutive members.
+		std::vector<unsigned long long> counts;
+	};
+
+	// Compacts the CFG in place.
+	ChainCompaction(CFG* cfg);
+	// Takes over the chains of a CFG compacted before, as read back by
+	// read(), so it can be expanded.
+	ChainCompaction(CFG* cfg, const std::vector<Chain>& chains);
+	virtual ~ChainCompaction();
+
+	CFG* cfg() const { return m_cfg; }
+	const std::vector<Chain>& chains() const { return m_chains; }
+
+	// Blocks before and after the compaction.
+	unsigned blocks() const { return m_blocks; }
+	unsigned compacted() const;
+
+	// Splits the superblocks back into their members.
+	void expand();
+
+	// Mapping of the superblocks to their members, with all that is
+	// needed to expand them back.
+	std::string str() const;
+
+	// Chains written by str(), by CFG address. The called functions and
+	// signal handlers are looked up in reader.
+	static std::map<Addr, std::vector<Chain>> read(std::istream& input,
+					const CFGReader& reader);
+
+private:
+	CFG* m_cfg;
+	unsigned m_blocks;
+	std::vector<Chain> m_chains;
+
+	void compact();
+
+};
+
+#endif
@@ -33,10 +33,19 @@
 class DCFGReader : public CFGReader {
 public:
 	DCFGReader(const std::string& filename);
+	DCFGReader(std::istream* input);
 	virtual ~DCFGReader();
 
 	virtual void loadCFGs();
 
+	bool useRoutines() const { return m_useRoutines; }
+	void setUseRoutines(bool useRoutines = true) { m_useRoutines = useRoutines; }
+
+	// Restrict the conversion to the given processes and images (by full
+	// path or file name). All of them are converted if none is given.
+	void addProcess(long pid) { m_processes.insert(pid); }
+	void addImage(const std::string& name) { m_images.insert(name); }
+
 private:
 	enum NodeType {
 		ENTRY_NODE = 1,
@@ -73,6 +82,8 @@ private:
 		UNKNOWN_EDGE
 	};
 
+	// Node ids are small dense integers, so nodes and edges are kept in
+	// vectors indexed by id. A node not in the tables has a null address.
 	struct Node {
 		Addr addr;
 		int size;
@@ -99,23 +110,75 @@ private:
 	};
 
 	std::vector<std::string> m_filenames;
-	std::map<int, Node> m_nodes;
-	std::map<int, std::list<Edge>> m_edges;
+	std::vector<Node> m_nodes;
 	std::list<Routine> m_routines;
 	std::map<Addr, Symbol> m_symbols;
 
-	std::set<int> m_entries;
-	std::set<int> m_visited;
+	// Edges in compressed sparse row form: the edges leaving node id
+	// are m_edges[m_edgesIndex[id]] up to m_edges[m_edgesIndex[id+1]].
+	std::vector<std::pair<int, Edge>> m_rawEdges;
+	std::vector<unsigned> m_edgesIndex;
+	std::vector<Edge> m_edges;
+
+	// Per CFG visited marks and nodes, valid when stamped with the
+	// current epoch, so they don't need to be cleared for each CFG.
+	struct BuildState {
+		unsigned epoch;
+		std::vector<unsigned> visitedEpoch;
+		std::vector<unsigned> nodesEpoch;
+		std::vector<CfgNode*> cfgNodes;
+	};
 
-	void buildCFG(int entry);
+	// A call or context change found while building a CFG, whose effects
+	// on the target CFG are applied later.
+	struct CrossEdge {
+		int src_id;
+		CfgNode* src_node;
+		int edge_type;
+		Addr dst_addr;
+		unsigned long long count;
+	};
+
+	// Where the parser is in the document.
+	struct ParseState {
+		std::vector<std::string> keys;
+		bool pidKnown;
+		bool processSelected;
+		bool imagesRead;
+		int fileId;
+		bool imageSelected;
+	};
 
-	void readProcesses(nlohmann::json& obj);
-	void readImages(nlohmann::json& array);
+	bool m_useRoutines;
+	std::set<long> m_processes;
+	std::set<std::string> m_images;
+	ParseState m_parse;
+	std::list<nlohmann::json> m_pendingImages;
+
+	std::set<int> m_entries;
+	std::vector<bool> m_visited;
+
+	bool hasNode(int id) const;
+	CfgNode* nodeWithId(CFG* cfg, BuildState& state, int id);
+	void buildEdges();
+	void initState(BuildState& state) const;
+	void buildCFG(int entry, BuildState& state, const Routine* routine = 0,
+					std::list<CrossEdge>* deferred = 0);
+	void applyCrossEdge(const CrossEdge& cross, bool update);
+	void buildCFGs();
+	void buildRoutineCFGs();
+	void releaseTables();
+
+	bool selectProcess(long pid) const;
+	bool selectImage(int file_id) const;
+	bool parseEvent(int depth, nlohmann::json::parse_event_t event,
+					nlohmann::json& parsed);
+	void readImage(nlohmann::json& row);
 	void readBasicBlocks(Addr baseAddr, nlohmann::json& array);
 	void readRoutines(nlohmann::json& array);
 	void readSymbols(int file_id, Addr baseAddr, nlohmann::json& array);
 	void readSourceData(int file_id, Addr baseAddr, nlohmann::json& array);
-	void readEdges(nlohmann::json& array);
+	void readEdge(nlohmann::json& row, bool store);
 
 };
 
@@ -0,0 +1,84 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#ifndef DOMINATOR_TREE_H
+#define DOMINATOR_TREE_H
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+class CFG;
+class CfgNode;
+
+// Dominator tree of a CFG computed with the Cooper-Harvey-Kennedy
+// iterative algorithm over a dense reverse postorder numbering.
+// The post-dominator tree is rooted in a virtual sink that succeeds
+// the exit, halt and phantom nodes. Nodes unreachable from the root
+// are not in the tree.
+class DominatorTree {
+public:
+	DominatorTree(const CFG* cfg, bool post = false);
+	virtual ~DominatorTree();
+
+	bool post() const { return m_post; }
+
+	// Root node, or 0 for the virtual sink.
+	CfgNode* root() const;
+
+	bool contains(CfgNode* node) const;
+
+	// Immediate dominator, or 0 for the root, unreachable nodes, and
+	// the nodes immediately post-dominated by the virtual sink.
+	CfgNode* immediateDominator(CfgNode* node) const;
+	std::vector<CfgNode*> children(CfgNode* node) const;
+
+	// Whether dom dominates node (both must be in the tree).
+	bool dominates(CfgNode* dom, CfgNode* node) const;
+
+	// One [dom] or [pdom] record per node: node and its immediate dominator.
+	std::string str() const;
+
+private:
+	const CFG* m_cfg;
+	bool m_post;
+
+	// Nodes in reverse postorder; the first is the root.
+	std::vector<CfgNode*> m_nodes;
+	std::unordered_map<CfgNode*, int> m_index;
+	std::vector<int> m_idom;
+
+	// Preorder interval of each node in the tree, for dominance queries.
+	std::vector<int> m_pre;
+	std::vector<int> m_last;
+
+	void number();
+	void compute();
+	void intervals();
+
+	std::vector<int> predecessors(int idx) const;
+	int intersect(int b1, int b2) const;
+
+};
+
+#endif
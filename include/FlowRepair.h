@@ -0,0 +1,76 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#ifndef FLOW_REPAIR_H
+#define FLOW_REPAIR_H
+
+#include <list>
+#include <vector>
+#include <string>
+
+class CFG;
+
+// Profile inference for INVALID CFGs, in the spirit of profi: the edge
+// counts are adjusted at minimum cost until every block conserves its
+// flow, the entry edge and the exits match the executions, and phantom
+// edges carry nothing. The adjustment is a minimum-cost flow solved by
+// primal-dual augmentation, where increasing a count costs
+// INCREASE_COST per unit and decreasing it DECREASE_COST, since lost
+// counts (truncated runs, fall-throughs recorded as 0) are more common
+// than spurious ones. CFGs whose structure is broken, such as blocks
+// without successors, cannot be fixed by counts and are left untouched.
+class FlowRepair {
+public:
+	struct Result {
+		CFG* cfg;
+		bool repaired;
+		// Sum of the absolute count changes.
+		unsigned long long adjustment;
+	};
+
+	static const long long INCREASE_COST = 1;
+	static const long long DECREASE_COST = 2;
+
+	FlowRepair(unsigned jobs = 1);
+	virtual ~FlowRepair();
+
+	// Repairs the INVALID CFGs, marking them as repaired. The results
+	// keep the order of cfgs, the address order of CFGReader::cfgs().
+	void repair(const std::list<CFG*>& cfgs);
+
+	// Repairs a single CFG; returns false if it cannot be repaired.
+	static bool repair(CFG* cfg, unsigned long long& adjustment);
+
+	const std::vector<Result>& results() const { return m_results; }
+	unsigned repaired() const;
+	unsigned long long adjustment() const;
+
+	std::string str() const;
+
+private:
+	unsigned m_jobs;
+	std::vector<Result> m_results;
+
+};
+
+#endif
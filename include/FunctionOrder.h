@@ -0,0 +1,80 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#ifndef FUNCTION_ORDER_H
+#define FUNCTION_ORDER_H
+
+#include <list>
+#include <vector>
+#include <string>
+
+class CFG;
+
+// Hot function order for the linker, computed with the C3 heuristic of
+// hfsort over the call graph weighted by the call counts. Following the
+// functions by decreasing density, each one is appended to the cluster
+// of its heaviest caller, unless the merged cluster would outgrow
+// MAX_CLUSTER_SIZE or dilute the caller's density by more than
+// MERGE_RATIO. The clusters are then laid out by decreasing density.
+class FunctionOrder {
+public:
+	struct Function {
+		CFG* cfg;
+		// Sum of the block sizes, in bytes.
+		unsigned long long size;
+		// Executed instructions.
+		unsigned long long samples;
+	};
+
+	static const unsigned long long MAX_CLUSTER_SIZE = 1 << 20;
+	static const unsigned MERGE_RATIO = 8;
+
+	// The CFGs come in address order, as CFGReader::cfgs() lists them,
+	// which also breaks the ties between equally dense functions.
+	FunctionOrder(const std::list<CFG*>& cfgs, unsigned jobs = 1);
+	virtual ~FunctionOrder();
+
+	const std::vector<Function>& functions() const { return m_functions; }
+
+	// Executed functions, in link order (indexes into functions()).
+	const std::vector<unsigned>& order() const { return m_order; }
+
+	// Symbol ordering file: one function name per line.
+	std::string str() const;
+
+private:
+	struct Arc {
+		unsigned caller;
+		unsigned callee;
+		unsigned long long count;
+	};
+
+	std::vector<Function> m_functions;
+	std::vector<unsigned> m_order;
+
+	void build(const std::list<CFG*>& cfgs, unsigned jobs, std::vector<Arc>& arcs);
+	void cluster(const std::vector<Arc>& arcs);
+
+};
+
+#endif
@@ -0,0 +1,66 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#ifndef HOT_SUBGRAPH_H
+#define HOT_SUBGRAPH_H
+
+#include <map>
+#include <vector>
+
+#include <Addr.h>
+
+class CFG;
+class CfgNode;
+
+// Hot part of a CFG, to keep the DOT output of huge functions readable.
+// A block is hot when its count reaches fraction of the executions and
+// it is among the top blocks by count (each criterion only applies when
+// given). The other blocks and phantoms are collapsed into cold regions,
+// the connected components they form, which CFG::toDOT draws as single
+// summary nodes with the edges into and out of them aggregated.
+class HotSubgraph {
+public:
+	struct Region {
+		Addr first;
+		Addr last;
+		unsigned blocks;
+		unsigned long long count;
+	};
+
+	HotSubgraph(const CFG* cfg, double fraction = 0, unsigned top = 0);
+	virtual ~HotSubgraph();
+
+	const CFG* cfg() const { return m_cfg; }
+
+	// Region of a collapsed node, or -1 if the node is shown.
+	int region(CfgNode* node) const;
+	const std::vector<Region>& regions() const { return m_regions; }
+
+private:
+	const CFG* m_cfg;
+	std::map<CfgNode*, int> m_region;
+	std::vector<Region> m_regions;
+
+};
+
+#endif
@@ -24,7 +24,7 @@
 #ifndef INPUT_TOKENIZER_H
 #define INPUT_TOKENIZER_H
 
-#include <fstream>
+#include <istream>
 #include <Addr.h>
 
 class InputTokenizer {
@@ -58,13 +58,13 @@ public:
 		virtual ~Lexeme() {}
 	};
 
-	InputTokenizer(std::fstream& input);
+	InputTokenizer(std::istream& input);
 	virtual ~InputTokenizer();
 
 	Lexeme nextToken();
 
 private:
-	std::fstream& m_input;
+	std::istream& m_input;
 
 	int nextChar();
 
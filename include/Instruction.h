@@ -25,6 +25,7 @@
 #define INSTRUCTION_H
 
 #include <map>
+#include <mutex>
 #include <string>
 
 #include <Addr.h>
@@ -41,12 +42,16 @@ public:
 	static void load(std::string filename);
 	static void clear();
 
+	// Release the instructions that were not loaded from an instructions map.
+	static void release();
+
 private:
 	Addr m_addr;
 	int m_size;
 	std::string m_text;
 
 	static std::map<Addr, Instruction*> m_instrsMap;
+	static std::mutex m_instrsMutex;
 
 	Instruction(Addr addr, int size, const std::string& text = "???");
 
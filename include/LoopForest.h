@@ -0,0 +1,84 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#ifndef LOOP_FOREST_H
+#define LOOP_FOREST_H
+
+#include <list>
+#include <vector>
+#include <unordered_map>
+
+class CFG;
+class CfgNode;
+
+// Loop nesting forest of a CFG, found with Havlak's algorithm, so that
+// irreducible loops (entered by more than one block) are also detected.
+class LoopForest {
+public:
+	struct Loop {
+		CfgNode* header;
+		bool reducible;
+		Loop* parent;
+		std::vector<Loop*> children;
+		// Blocks of this loop that are not in a nested loop.
+		std::vector<CfgNode*> blocks;
+		unsigned depth;
+
+		// Blocks including the nested loops.
+		unsigned long long size;
+		// Counts of the edges entering the loop and going back to its header.
+		unsigned long long entries;
+		unsigned long long backEdges;
+		// Dynamic instructions executed in the loop (one per block
+		// when instructions are unknown).
+		unsigned long long weight;
+
+		// Average iterations per entry.
+		double tripCount() const {
+			return entries > 0 ? (double) (entries + backEdges) / entries : 0.0;
+		}
+	};
+
+	LoopForest(const CFG* cfg);
+	virtual ~LoopForest();
+
+	const CFG* cfg() const { return m_cfg; }
+
+	// All loops, outermost first.
+	const std::list<Loop*>& loops() const { return m_loops; }
+
+	// Innermost loop containing node, or 0.
+	Loop* loopOf(CfgNode* node) const;
+	bool contains(const Loop* loop, CfgNode* node) const;
+
+private:
+	const CFG* m_cfg;
+	std::list<Loop*> m_loops;
+	std::unordered_map<CfgNode*, Loop*> m_loopOf;
+
+	void find();
+	void measure();
+
+};
+
+#endif
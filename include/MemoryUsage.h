@@ -0,0 +1,42 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#ifndef MEMORY_USAGE_H
+#define MEMORY_USAGE_H
+
+class MemoryUsage {
+public:
+	// Sizes in kilobytes, or zero if unavailable.
+	static unsigned long currentRSS();
+	static unsigned long peakRSS();
+
+	// Restart the peak tracking, so peakRSS() reports the peak since
+	// this call (Linux only).
+	static void resetPeak();
+
+	// Return the freed heap memory to the system, when supported.
+	static void trim();
+
+};
+
+#endif
@@ -0,0 +1,63 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#ifndef PROFILE_WRITER_H
+#define PROFILE_WRITER_H
+
+#include <list>
+#include <vector>
+#include <string>
+
+class CFG;
+
+// Translates the CFGs into the profile formats consumed by post-link
+// optimizers, so they can be driven without a perf-based collection.
+class ProfileWriter {
+public:
+	// The profiles list the CFGs in the given order, the address order
+	// of CFGReader::cfgs().
+	ProfileWriter(const std::list<CFG*>& cfgs, unsigned jobs = 1);
+	virtual ~ProfileWriter();
+
+	// LLVM BOLT branch profile (.fdata). Each taken or conditional edge
+	// goes from the offset of the block's last instruction to the offset
+	// of the successor, and each call to offset 0 of the callee. Jumps
+	// into the next block of a block with a single successor are not
+	// branches and are left for BOLT to infer.
+	std::string toFData() const;
+
+	// Sample profile in the LLVM text format. Without debug information
+	// the line offsets are the byte offsets of the blocks from the entry,
+	// and their samples the block execution counts.
+	std::string toSampleProfile() const;
+
+private:
+	std::vector<CFG*> m_cfgs;
+	unsigned m_jobs;
+
+	// Concatenates, in address order, the output of writer for each CFG.
+	std::string write(std::string (*writer)(const CFG*)) const;
+
+};
+
+#endif
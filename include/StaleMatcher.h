@@ -0,0 +1,79 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#ifndef STALE_MATCHER_H
+#define STALE_MATCHER_H
+
+#include <list>
+#include <vector>
+#include <string>
+
+#include <CFGHash.h>
+
+class CFG;
+
+// Carries the counts of a stale profile over to the CFGs of a rebuilt
+// binary. Functions are matched by unique name, then by unique CFGHash.
+// Within a function pair, blocks are matched by unique shape hash, and
+// the rest by opcode hash in address order. The counts of the edges,
+// calls and signal handlers between matched blocks are carried over;
+// whatever cannot be matched is lost, which FlowRepair can fill in.
+class StaleMatcher {
+public:
+	StaleMatcher(unsigned jobs = 1);
+	virtual ~StaleMatcher();
+
+	// Hash the stale profile. Its instructions are no longer needed
+	// afterwards, so they can be released before loading the new CFGs.
+	void setProfile(const std::list<CFG*>& profile);
+
+	// Replace the counts of the CFGs with the ones matched in the profile.
+	// The CFGs cache their hashes (see CFG::hash()), so matching again
+	// after a few of them change only rehashes those.
+	void match(const std::list<CFG*>& cfgs);
+
+	unsigned functions() const { return m_functions; }
+	unsigned matchedByName() const { return m_byName; }
+	unsigned matchedByHash() const { return m_byHash; }
+	unsigned long long blocks() const { return m_blocks; }
+	unsigned long long matchedBlocks() const { return m_matchedBlocks; }
+	unsigned long long count() const { return m_count; }
+	unsigned long long carriedCount() const { return m_carriedCount; }
+
+	std::string str() const;
+
+private:
+	unsigned m_jobs;
+	std::vector<CFGHash*> m_profile;
+
+	unsigned m_functions;
+	unsigned m_byName;
+	unsigned m_byHash;
+	unsigned long long m_blocks;
+	unsigned long long m_matchedBlocks;
+	unsigned long long m_count;
+	unsigned long long m_carriedCount;
+
+};
+
+#endif
@@ -0,0 +1,64 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+class ThreadPool {
+public:
+	ThreadPool(unsigned threads = 0, unsigned maxPending = 0);
+	virtual ~ThreadPool();
+
+	unsigned threads() const { return m_workers.empty() ? 1 : m_workers.size(); }
+
+	void submit(const std::function<void()>& task);
+	void wait();
+
+	static unsigned defaultThreads();
+
+private:
+	std::vector<std::thread> m_workers;
+	std::list<std::function<void()>> m_tasks;
+	unsigned m_maxPending;
+	unsigned m_running;
+	bool m_stop;
+	std::exception_ptr m_error;
+
+	std::mutex m_mutex;
+	std::condition_variable m_taskReady;
+	std::condition_variable m_taskTaken;
+	std::condition_variable m_taskDone;
+
+	void work();
+
+};
+
+#endif
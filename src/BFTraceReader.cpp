@@ -20,31 +20,62 @@
    The GNU General Public License is contained in the file COPYING.
 */
 
+#include <vector>
 #include <cassert>
-#include <algorithm>
+#include <sstream>
+#include <unordered_set>
 
 #include <CFG.h>
 #include <CfgNode.h>
+#include <ThreadPool.h>
 #include <BFTraceReader.h>
 
 BFTraceReader::BFTraceReader(const std::string& filename)
 	: CFGReader(filename), m_tokens(m_input), m_current(m_tokens.nextToken()) {
 }
 
+BFTraceReader::BFTraceReader(std::istream* input)
+	: CFGReader(input), m_tokens(m_input), m_current(m_tokens.nextToken()) {
+}
+
 BFTraceReader::~BFTraceReader() {
 }
 
 void BFTraceReader::loadCFGs() {
+	// The symbols are independent from each other, so their CFGs can be
+	// built concurrently. Limit the symbols waiting to be built, so the
+	// memory is bounded by the largest ones instead of the whole input.
+	unsigned threads = (m_jobs > 0 ? m_jobs : ThreadPool::defaultThreads());
+	ThreadPool pool(threads, threads);
+
+	// The CFGs are built and checked while the symbols are parsed.
+	this->startPhases();
+
+	// Release the symbol's blocks and edges as soon as its CFGs are built.
+	this->readSymbols([this, &pool](Symbol* sym) {
+		pool.submit([this, sym] {
+			this->buildCFGs(sym);
+			delete sym;
+		});
+	});
+
+	pool.wait();
+	this->endPhase("build");
+}
+
+void BFTraceReader::readSymbols(const std::function<void(Symbol*)>& handler) {
 	Symbol* sym = 0;
-	std::list<Symbol*> symbols;
 
 	while (m_current.type == InputTokenizer::Lexeme::TKN_KEYWORD) {
 		std::string keyword = m_current.token;
 		matchToken(InputTokenizer::Lexeme::TKN_KEYWORD);
 
 		if (keyword == "symbol") {
+			// The blocks and branches of a symbol follow its header,
+			// so the previous symbol is complete.
+			if (sym)
+				handler(sym);
 			sym = new Symbol();
-			symbols.push_back(sym);
 
 			sym->start = m_current.data.addr;
 			matchToken(InputTokenizer::Lexeme::TKN_ADDR);
@@ -61,15 +92,19 @@ void BFTraceReader::loadCFGs() {
 			sym->bias = m_current.data.addr;
 			matchToken(InputTokenizer::Lexeme::TKN_ADDR);
 		} else if (keyword == "program-entry") {
+			if (sym)
+				handler(sym);
 			sym = 0;
 			matchToken(InputTokenizer::Lexeme::TKN_ADDR);
 			matchToken(InputTokenizer::Lexeme::TKN_ADDR);
 		} else if (keyword == "block") {
-			assert(sym != 0);
+			if (sym == 0)
+				throw std::string("Block outside of a symbol");
 
 			Addr faddr = m_current.data.addr;
 			matchToken(InputTokenizer::Lexeme::TKN_ADDR);
-			assert(faddr == sym->start);
+			if (faddr != sym->start)
+				throw std::string("Block outside of its symbol: ") + sym->functname;
 
 			Addr bb_addr = m_current.data.addr;
 			matchToken(InputTokenizer::Lexeme::TKN_ADDR);
@@ -89,10 +124,10 @@ void BFTraceReader::loadCFGs() {
 				bb.type = BFTraceReader::CALL;
 			else if (term_type == "return")
 				bb.type = BFTraceReader::RETURN;
-			else {
-				assert(term_type == "other");
+			else if (term_type == "other")
 				bb.type = BFTraceReader::OTHER;
-			}
+			else
+				throw std::string("Invalid block terminator: ") + term_type;
 
 			bool is_entry = m_current.data.boolean;
 			matchToken(InputTokenizer::Lexeme::TKN_BOOL);
@@ -109,7 +144,8 @@ void BFTraceReader::loadCFGs() {
 			matchToken(InputTokenizer::Lexeme::TKN_ADDR);
 			matchToken(InputTokenizer::Lexeme::TKN_ADDR);
 		} else if (keyword == "br") {
-			assert(sym != 0);
+			if (sym == 0)
+				throw std::string("Branch outside of a symbol");
 
 			Addr src = m_current.data.addr;
 			matchToken(InputTokenizer::Lexeme::TKN_ADDR);
@@ -119,64 +155,89 @@ void BFTraceReader::loadCFGs() {
 
 			sym->edges[src].insert(dst);
 		} else {
-			assert(false);
+			throw std::string("Invalid record: ") + keyword;
 		}
 	}
 
 	matchToken(InputTokenizer::Lexeme::TKN_EOF);
 
-	for (Symbol* sym : symbols) {
-		for (Addr entry : sym->entries) {
-			CFG* cfg = this->instance(entry);
-			cfg->setFunctionName(sym->filename + "::" + sym->functname);
-
-			std::list<Addr> nodes;
-			nodes.push_back(entry);
-			for (std::list<Addr>::iterator it = nodes.begin(), ed = nodes.end();
-					it != ed; ++it) {
-				Addr addr = *it;
-				assert(addr != 0);
-
-				assert(sym->blocks.find(addr) != sym->blocks.end());
-				BasicBlock& bb = sym->blocks[addr];
-
-				CfgNode* node = cfg->nodeByAddr(addr);
-				if (node == 0) {
-					node = new CfgNode(CfgNode::CFG_BLOCK);
-					node->setData(new CfgNode::BlockData(addr, bb.size));
-					cfg->addNode(node);
-				} else {
-					assert(node->type() == CfgNode::CFG_PHANTOM);
-					node->setData(new CfgNode::BlockData(addr, bb.size));
-				}
+	if (sym)
+		handler(sym);
+}
 
-				if (addr == entry) {
-					assert(cfg->entryNode() == 0);
-					CfgNode* entry = CFGReader::entryNode(cfg);
-					cfg->addEdge(entry, node);
-				}
+void BFTraceReader::buildCFGs(Symbol* sym) {
+	for (Addr entry : sym->entries) {
+		CFG* cfg = this->instance(entry);
+		cfg->setFunctionName(sym->filename + "::" + sym->functname);
+
+		std::vector<Addr> nodes;
+		std::unordered_set<Addr> queued;
+
+		nodes.push_back(entry);
+		queued.insert(entry);
+		for (std::vector<Addr>::size_type i = 0; i < nodes.size(); i++) {
+			Addr addr = nodes[i];
+			assert(addr != 0);
+
+			std::map<Addr, BasicBlock>::const_iterator it = sym->blocks.find(addr);
+			if (it == sym->blocks.end()) {
+				std::stringstream ss;
+				ss << "Unknown block 0x" << std::hex << addr << " in symbol: "
+				   << sym->functname;
+				throw ss.str();
+			}
+			const BasicBlock& bb = it->second;
+
+			CfgNode* node = cfg->nodeByAddr(addr);
+			if (node == 0) {
+				node = new CfgNode(CfgNode::CFG_BLOCK);
+				node->setData(new CfgNode::BlockData(addr, bb.size));
+				cfg->addNode(node);
+			} else {
+				cfg->promotePhantom(node, bb.size);
+			}
 
-				if (bb.is_exit || bb.type == BFTraceReader::RETURN) {
-					CfgNode* exit = CFGReader::exitNode(cfg);
-					cfg->addEdge(node, exit);
+			if (addr == entry) {
+				if (cfg->entryNode() != 0) {
+					std::stringstream ss;
+					ss << "Duplicated entry 0x" << std::hex << entry << " in symbol: "
+					   << sym->functname;
+					throw ss.str();
 				}
 
-				for (Addr dst : sym->edges[addr]) {
-					cfg->addEdge(node, CFGReader::nodeWithAddr(cfg, dst));
+				CfgNode* entry = CFGReader::entryNode(cfg);
+				cfg->addEdge(entry, node);
+			}
 
-					if (std::find(nodes.begin(), ed, dst) == ed)
-						nodes.push_back(dst);
-				}
+			if (bb.is_exit || bb.type == BFTraceReader::RETURN) {
+				CfgNode* exit = CFGReader::exitNode(cfg);
+				cfg->addEdge(node, exit);
 			}
 
-			cfg->check();
+			std::map<Addr, std::set<Addr>>::const_iterator it2 = sym->edges.find(addr);
+			if (it2 == sym->edges.end())
+				continue;
+
+			for (Addr dst : it2->second) {
+				cfg->addEdge(node, CFGReader::nodeWithAddr(cfg, dst));
+
+				if (queued.insert(dst).second)
+					nodes.push_back(dst);
+			}
 		}
 
-		delete sym;
+		cfg->check();
 	}
 }
 
 void BFTraceReader::matchToken(InputTokenizer::Lexeme::Type type) {
-	assert(m_current.type == type);
+	if (m_current.type != type) {
+		if (m_current.type == InputTokenizer::Lexeme::TKN_EOF ||
+				m_current.type == InputTokenizer::Lexeme::TKN_UNEXPECTED_EOF)
+			throw std::string("Unexpected end of bftrace input");
+
+		throw std::string("Invalid bftrace format near: ") + m_current.token;
+	}
+
 	m_current = m_tokens.nextToken();
 }
@@ -0,0 +1,374 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#include <map>
+#include <queue>
+#include <cassert>
+#include <sstream>
+#include <algorithm>
+#include <unordered_map>
+
+#include <CFG.h>
+#include <CfgEdge.h>
+#include <CfgNode.h>
+#include <BlockLayout.h>
+
+// Ext-TSP parameters: fall-through edges have weight 1, jumps up to
+// 1024 bytes forward or 640 bytes backward decay from 0.1 to 0.
+static const double FORWARD_WEIGHT = 0.1;
+static const double BACKWARD_WEIGHT = 0.1;
+static const double FORWARD_DISTANCE = 1024;
+static const double BACKWARD_DISTANCE = 640;
+
+static
+double extTSP(unsigned long long srcEnd, unsigned long long dstStart,
+		unsigned long long weight) {
+	if (srcEnd == dstStart)
+		return weight;
+
+	if (dstStart > srcEnd) {
+		double distance = dstStart - srcEnd;
+		if (distance <= FORWARD_DISTANCE)
+			return weight * FORWARD_WEIGHT * (1.0 - distance / FORWARD_DISTANCE);
+	} else {
+		double distance = srcEnd - dstStart;
+		if (distance <= BACKWARD_DISTANCE)
+			return weight * BACKWARD_WEIGHT * (1.0 - distance / BACKWARD_DISTANCE);
+	}
+
+	return 0;
+}
+
+BlockLayout::BlockLayout(const CFG* cfg) : m_cfg(cfg), m_originalScore(0), m_score(0) {
+	this->compute();
+}
+
+BlockLayout::~BlockLayout() {
+}
+
+namespace {
+
+struct Block {
+	Addr addr;
+	unsigned long long size;
+	unsigned long long count;
+};
+
+struct Edge {
+	int src;
+	int dst;
+	unsigned long long weight;
+};
+
+struct Layout {
+	std::vector<Block> blocks;
+	std::vector<Edge> edges;
+	int entry;
+
+	std::vector<std::vector<int>> chains;
+	std::vector<int> chainOf;
+	std::vector<unsigned long long> offset;
+	std::vector<unsigned long long> chainSize;
+
+	// Edges between each chain and its neighbours, kept on both sides.
+	std::vector<std::map<int, std::vector<int>>> adjacent;
+	// Bumped whenever a chain changes, to retire its queued candidates.
+	std::vector<unsigned> stamp;
+
+	void append(int x, int y) {
+		for (int b : chains[y]) {
+			offset[b] += chainSize[x];
+			chainOf[b] = x;
+			chains[x].push_back(b);
+		}
+
+		chainSize[x] += chainSize[y];
+		chains[y].clear();
+		chainSize[y] = 0;
+
+		// The edges of the absorbed chain now belong to the merged one.
+		for (std::pair<const int, std::vector<int>>& entry : adjacent[y]) {
+			int z = entry.first;
+			adjacent[z].erase(y);
+			if (z == x)
+				continue;
+
+			std::vector<int>& edges = adjacent[x][z];
+			edges.insert(edges.end(), entry.second.cbegin(), entry.second.cend());
+			adjacent[z][x] = edges;
+		}
+		adjacent[x].erase(y);
+		adjacent[y].clear();
+
+		stamp[x]++;
+		stamp[y]++;
+	}
+
+	// Score of the edges between x and y if y is placed right after x.
+	double gain(int x, int y, const std::vector<int>& edges) const {
+		double score = 0;
+		for (int e : edges) {
+			const Edge& edge = this->edges[e];
+			unsigned long long src = offset[edge.src] + (chainOf[edge.src] == y ? chainSize[x] : 0);
+			unsigned long long dst = offset[edge.dst] + (chainOf[edge.dst] == y ? chainSize[x] : 0);
+
+			score += extTSP(src + blocks[edge.src].size, dst, edge.weight);
+		}
+
+		return score;
+	}
+
+	bool containsEntry(int chain) const {
+		return entry >= 0 && chainOf[entry] == chain;
+	}
+};
+
+// Placing chain y right after chain x, worth gain when queued.
+struct Candidate {
+	double gain;
+	int x;
+	int y;
+	unsigned stampX;
+	unsigned stampY;
+
+	// Best gain first; ties go to the lower pair of chains, the lower
+	// chain placed first.
+	bool operator<(const Candidate& other) const {
+		if (gain != other.gain)
+			return gain < other.gain;
+
+		std::pair<int, int> p1(std::min(x, y), std::max(x, y));
+		std::pair<int, int> p2(std::min(other.x, other.y), std::max(other.x, other.y));
+		if (p1 != p2)
+			return p1 > p2;
+
+		return x > other.x;
+	}
+};
+
+}
+
+static
+double score(const std::vector<Block>& blocks, const std::vector<Edge>& edges,
+		const std::vector<int>& order) {
+	std::vector<unsigned long long> offset(blocks.size(), 0);
+	unsigned long long current = 0;
+	for (int b : order) {
+		offset[b] = current;
+		current += blocks[b].size;
+	}
+
+	double total = 0;
+	for (const Edge& edge : edges)
+		total += extTSP(offset[edge.src] + blocks[edge.src].size, offset[edge.dst], edge.weight);
+
+	return total;
+}
+
+void BlockLayout::compute() {
+	Layout layout;
+	layout.entry = -1;
+
+	std::vector<CfgNode*> nodes;
+	for (CfgNode* node : m_cfg->nodes()) {
+		if (node->type() == CfgNode::CFG_BLOCK)
+			nodes.push_back(node);
+	}
+	std::sort(nodes.begin(), nodes.end(), CfgNode::nodeOrder);
+
+	std::unordered_map<CfgNode*, int> index;
+	for (CfgNode* node : nodes) {
+		CfgNode::BlockData* data = static_cast<CfgNode::BlockData*>(node->data());
+		assert(data != 0);
+
+		Block block;
+		block.addr = data->addr();
+		block.size = (data->size() > 0 ? data->size() : 1);
+		block.count = m_cfg->blockCount(node);
+
+		index[node] = layout.blocks.size();
+		if (block.addr == m_cfg->addr())
+			layout.entry = layout.blocks.size();
+
+		layout.blocks.push_back(block);
+	}
+
+	for (CfgNode* node : nodes) {
+		for (CfgNode* succ : m_cfg->successors(node)) {
+			std::unordered_map<CfgNode*, int>::const_iterator it = index.find(succ);
+			if (it == index.end() || succ == node)
+				continue;
+
+			CfgEdge* edge = m_cfg->findEdge(node, succ);
+			assert(edge != 0);
+			if (edge->count() == 0)
+				continue;
+
+			Edge e = { index[node], it->second, edge->count() };
+			layout.edges.push_back(e);
+		}
+	}
+
+	int size = layout.blocks.size();
+	std::vector<int> original(size);
+	for (int b = 0; b < size; b++)
+		original[b] = b;
+	m_originalScore = ::score(layout.blocks, layout.edges, original);
+
+	layout.chains.resize(size);
+	layout.chainOf.resize(size);
+	layout.offset.assign(size, 0);
+	layout.chainSize.resize(size);
+	layout.adjacent.resize(size);
+	layout.stamp.assign(size, 0);
+	for (int b = 0; b < size; b++) {
+		layout.chains[b].push_back(b);
+		layout.chainOf[b] = b;
+		layout.chainSize[b] = layout.blocks[b].size;
+	}
+
+	// Pettis-Hansen: chain the heaviest fall-throughs first.
+	std::vector<int> sorted(layout.edges.size());
+	for (std::vector<int>::size_type e = 0; e < sorted.size(); e++)
+		sorted[e] = e;
+	std::stable_sort(sorted.begin(), sorted.end(), [&layout](int e1, int e2) {
+		return layout.edges[e1].weight > layout.edges[e2].weight;
+	});
+
+	for (int e : sorted) {
+		const Edge& edge = layout.edges[e];
+		int x = layout.chainOf[edge.src];
+		int y = layout.chainOf[edge.dst];
+		if (x != y && layout.chains[x].back() == edge.src &&
+				layout.chains[y].front() == edge.dst && !layout.containsEntry(y))
+			layout.append(x, y);
+	}
+
+	// Ext-TSP: concatenate the pair of chains with the best gain. Only
+	// the pairs touching a merged chain change, so the gains are queued
+	// and refreshed just for those.
+	for (std::vector<Edge>::size_type e = 0; e < layout.edges.size(); e++) {
+		int x = layout.chainOf[layout.edges[e].src];
+		int y = layout.chainOf[layout.edges[e].dst];
+		if (x != y) {
+			layout.adjacent[x][y].push_back(e);
+			layout.adjacent[y][x].push_back(e);
+		}
+	}
+
+	std::priority_queue<Candidate> queue;
+	auto propose = [&layout, &queue](int x, int y, const std::vector<int>& edges) {
+		if (layout.containsEntry(y))
+			return;
+
+		double gain = layout.gain(x, y, edges);
+		if (gain > 0) {
+			Candidate candidate = { gain, x, y, layout.stamp[x], layout.stamp[y] };
+			queue.push(candidate);
+		}
+	};
+
+	for (int x = 0; x < size; x++) {
+		for (const std::pair<const int, std::vector<int>>& entry : layout.adjacent[x])
+			propose(x, entry.first, entry.second);
+	}
+
+	while (!queue.empty()) {
+		Candidate candidate = queue.top();
+		queue.pop();
+
+		if (candidate.stampX != layout.stamp[candidate.x] ||
+				candidate.stampY != layout.stamp[candidate.y])
+			continue;
+
+		int x = candidate.x;
+		layout.append(x, candidate.y);
+
+		for (const std::pair<const int, std::vector<int>>& entry : layout.adjacent[x]) {
+			propose(x, entry.first, entry.second);
+			propose(entry.first, x, entry.second);
+		}
+	}
+
+	// Entry chain first, then the executed chains by decreasing density.
+	std::vector<int> chains;
+	for (int c = 0; c < size; c++) {
+		if (!layout.chains[c].empty())
+			chains.push_back(c);
+	}
+
+	auto weight = [&layout](int c) {
+		unsigned long long total = 0;
+		for (int b : layout.chains[c])
+			total += layout.blocks[b].count;
+		return total;
+	};
+
+	std::stable_sort(chains.begin(), chains.end(), [&layout, &weight](int c1, int c2) {
+		if (layout.containsEntry(c1) != layout.containsEntry(c2))
+			return layout.containsEntry(c1);
+
+		double d1 = (double) weight(c1) / layout.chainSize[c1];
+		double d2 = (double) weight(c2) / layout.chainSize[c2];
+		return d1 > d2;
+	});
+
+	std::vector<int> order;
+	for (int c : chains) {
+		bool cold = (weight(c) == 0 && !layout.containsEntry(c));
+		for (int b : layout.chains[c]) {
+			order.push_back(b);
+			if (cold)
+				m_cold.push_back(layout.blocks[b].addr);
+			else
+				m_order.push_back(layout.blocks[b].addr);
+		}
+	}
+
+	m_score = ::score(layout.blocks, layout.edges, order);
+}
+
+std::string BlockLayout::str() const {
+	std::stringstream ss;
+
+	ss << std::hex << "[layout 0x" << m_cfg->addr() << " [";
+	for (std::vector<Addr>::const_iterator it = m_order.cbegin(),
+			ed = m_order.cend(); it != ed; ++it) {
+		if (it != m_order.cbegin())
+			ss << " ";
+
+		ss << "0x" << *it;
+	}
+
+	ss << "] [";
+	for (std::vector<Addr>::const_iterator it = m_cold.cbegin(),
+			ed = m_cold.cend(); it != ed; ++it) {
+		if (it != m_cold.cbegin())
+			ss << " ";
+
+		ss << "0x" << *it;
+	}
+	ss << "]]" << std::endl;
+
+	return ss.str();
+}
@@ -22,6 +22,7 @@
 */
 
 #include <iomanip>
+#include <vector>
 #include <sstream>
 #include <cassert>
 #include <algorithm>
@@ -29,13 +30,19 @@
 #include <CFG.h>
 #include <CfgNode.h>
 #include <CfgEdge.h>
+#include <CFGHash.h>
+#include <DominatorTree.h>
+#include <HotSubgraph.h>
 
 CFG::CFG(Addr addr, unsigned long long execs) : m_addr(addr), m_status(CFG::UNCHECKED),
-		m_functionName("unknown"), m_complete(false),
-		m_entryNode(0), m_exitNode(0), m_haltNode(0), m_execs(execs) {
+		m_functionName("unknown"), m_complete(false), m_repaired(false),
+		m_entryNode(0), m_exitNode(0), m_haltNode(0), m_execs(execs),
+		m_domTree(0), m_postDomTree(0), m_hash(0) {
 }
 
 CFG::~CFG() {
+	this->invalidate();
+
 	for (CfgNode* node : m_nodes)
 		delete node;
 
@@ -90,17 +97,59 @@ void CFG::addNode(CfgNode* node) {
 
 	m_nodes.insert(node);
 	m_status = CFG::UNCHECKED;
+	this->invalidate();
 }
 
-CfgEdge* CFG::findEdge(CfgNode* src, CfgNode* dst) const {
-	if (this->containsNode(src) && this->containsNode(dst)) {
-		for (CfgEdge* edge : this->edges()) {
-			if (edge->source() == src && edge->destination() == dst)
-				return edge;
-		}
+void CFG::removeNode(CfgNode* node) {
+	assert(node != 0 && this->containsNode(node));
+
+	std::set<CfgNode*> succs = this->successors(node);
+	for (CfgNode* succ : succs)
+		this->removeEdge(node, succ);
+
+	std::set<CfgNode*> preds = this->predecessors(node);
+	for (CfgNode* pred : preds)
+		this->removeEdge(pred, node);
+
+	switch (node->type()) {
+		case CfgNode::CFG_ENTRY:
+			m_entryNode = 0;
+			break;
+		case CfgNode::CFG_BLOCK:
+		case CfgNode::CFG_PHANTOM:
+			m_nodesMap.erase(CfgNode::node2addr(node));
+			break;
+		case CfgNode::CFG_EXIT:
+			m_exitNode = 0;
+			break;
+		case CfgNode::CFG_HALT:
+			m_haltNode = 0;
+			break;
+		default:
+			assert(false);
 	}
 
-	return 0;
+	m_nodes.erase(node);
+	delete node;
+
+	m_status = CFG::UNCHECKED;
+	this->invalidate();
+}
+
+void CFG::promotePhantom(CfgNode* node, int size) {
+	assert(node != 0 && this->containsNode(node));
+	assert(node->type() == CfgNode::CFG_PHANTOM);
+
+	node->setData(new CfgNode::BlockData(CfgNode::node2addr(node), size));
+
+	m_status = CFG::UNCHECKED;
+	this->invalidate();
+}
+
+CfgEdge* CFG::findEdge(CfgNode* src, CfgNode* dst) const {
+	std::map<std::pair<CfgNode*, CfgNode*>, CfgEdge*>::const_iterator it =
+		m_edgesMap.find(std::make_pair(src, dst));
+	return it != m_edgesMap.end() ? it->second : 0;
 }
 
 void CFG::addEdge(CfgNode* src, CfgNode* dst, unsigned long long count) {
@@ -115,14 +164,69 @@ void CFG::addEdge(CfgNode* src, CfgNode* dst, unsigned long long count) {
 		// Create and add edge.
 		edge = new CfgEdge(src, dst, count);
 		m_edges.insert(edge);
+		m_edgesMap[std::make_pair(src, dst)] = edge;
 
 		m_succs[src].insert(dst);
 		m_preds[dst].insert(src);
 
 		m_status = CFG::UNCHECKED;
+		this->invalidate();
 	}
 }
 
+void CFG::removeEdge(CfgNode* src, CfgNode* dst) {
+	CfgEdge* edge = this->findEdge(src, dst);
+	assert(edge != 0);
+
+	m_edges.erase(edge);
+	m_edgesMap.erase(std::make_pair(src, dst));
+
+	m_succs[src].erase(dst);
+	if (m_succs[src].empty())
+		m_succs.erase(src);
+
+	m_preds[dst].erase(src);
+	if (m_preds[dst].empty())
+		m_preds.erase(dst);
+
+	delete edge;
+
+	m_status = CFG::UNCHECKED;
+	this->invalidate();
+}
+
+const DominatorTree& CFG::dominatorTree() const {
+	if (!m_domTree)
+		m_domTree = new DominatorTree(this);
+
+	return *m_domTree;
+}
+
+const DominatorTree& CFG::postDominatorTree() const {
+	if (!m_postDomTree)
+		m_postDomTree = new DominatorTree(this, true);
+
+	return *m_postDomTree;
+}
+
+const CFGHash& CFG::hash() const {
+	if (!m_hash)
+		m_hash = new CFGHash(this);
+
+	return *m_hash;
+}
+
+void CFG::invalidate() {
+	delete m_domTree;
+	m_domTree = 0;
+
+	delete m_postDomTree;
+	m_postDomTree = 0;
+
+	delete m_hash;
+	m_hash = 0;
+}
+
 static std::set<CfgNode*> emptyset;
 
 const std::set<CfgNode*>& CFG::successors(CfgNode* node) const {
@@ -139,9 +243,22 @@ const std::set<CfgNode*>& CFG::predecessors(CfgNode* node) const {
 	return (it != m_preds.end() ? it->second : emptyset);
 }
 
+unsigned long long CFG::blockCount(CfgNode* node) const {
+	unsigned long long count = 0;
+	for (CfgNode* pred : this->predecessors(node)) {
+		CfgEdge* edge = this->findEdge(pred, node);
+		assert(edge != 0);
+
+		count += edge->count();
+	}
+
+	return count;
+}
+
 enum CFG::Status CFG::check() {
 	m_complete = true;
 	m_status = CFG::INVALID;
+	unsigned long long entering = 0;
 	unsigned long long leaving = 0;
 
 	if (!m_entryNode || (!m_exitNode && !m_haltNode))
@@ -163,15 +280,10 @@ enum CFG::Status CFG::check() {
 
 				CfgEdge* edge = this->findEdge(node, dst);
 				assert(edge != 0);
-				if (edge->count() != this->execs())
-					goto out;
+				entering = edge->count();
 
 				} break;
 			case CfgNode::CFG_BLOCK: {
-				if (this->predecessors(node).size() == 0 ||
-					this->successors(node).size() == 0)
-					goto out;
-
 				CfgNode::BlockData* bdata =
 					static_cast<CfgNode::BlockData*>(node->data());
 				assert(bdata != 0);
@@ -194,15 +306,12 @@ enum CFG::Status CFG::check() {
 					succs_count += edge->count();
 				}
 
-				if (preds_count != succs_count)
+				if (!CFG::validBlock(true, !this->predecessors(node).empty(),
+						!this->successors(node).empty(), preds_count, succs_count))
 					goto out;
 
 				} break;
 			case CfgNode::CFG_PHANTOM: {
-				if (this->predecessors(node).size() == 0 ||
-					this->successors(node).size() != 0)
-					goto out;
-
 				assert(node->data() != 0);
 				m_complete = false;
 
@@ -214,7 +323,8 @@ enum CFG::Status CFG::check() {
 					preds_count += edge->count();
 				}
 
-				if (preds_count != 0)
+				if (!CFG::validBlock(false, !this->predecessors(node).empty(),
+						!this->successors(node).empty(), preds_count, 0))
 					goto out;
 
 				} break;
@@ -237,7 +347,7 @@ enum CFG::Status CFG::check() {
 		}
 	}
 
-	if (leaving != this->execs())
+	if (!CFG::validFlow(entering, leaving, this->execs()))
 		goto out;
 
 	m_status = CFG::VALID;
@@ -246,6 +356,22 @@ out:
 	return m_status;
 }
 
+bool CFG::validBlock(bool defined, bool reached, bool leaves,
+		unsigned long long inflow, unsigned long long outflow) {
+	if (!reached)
+		return false;
+
+	if (!defined)
+		return !leaves && inflow == 0;
+
+	return leaves && inflow == outflow;
+}
+
+bool CFG::validFlow(unsigned long long entryCount,
+		unsigned long long exitCount, unsigned long long execs) {
+	return entryCount == execs && exitCount == execs;
+}
+
 static
 std::string dotFilter(const std::string& name) {
 	std::stringstream ss;
@@ -262,18 +388,50 @@ std::string dotFilter(const std::string& name) {
 	return ss.str();
 }
 
-std::string CFG::toDOT() const {
+static
+std::string dotName(CfgNode* node, const HotSubgraph* hot) {
+	std::stringstream ss;
+
+	int region = (hot ? hot->region(node) : -1);
+	if (region >= 0) {
+		ss << "\"Cold" << std::dec << region << "\"";
+		return ss.str();
+	}
+
+	switch (node->type()) {
+		case CfgNode::CFG_ENTRY:
+			return "Entry";
+		case CfgNode::CFG_EXIT:
+			return "Exit";
+		case CfgNode::CFG_HALT:
+			return "Halt";
+		case CfgNode::CFG_BLOCK:
+		case CfgNode::CFG_PHANTOM:
+			ss << std::hex << "\"0x" << CfgNode::node2addr(node) << "\"";
+			return ss.str();
+		default:
+			assert(false);
+	}
+
+	return "";
+}
+
+std::string CFG::toDOT(const HotSubgraph* hot) const {
 	std::stringstream ss;
 	int unknown = 1;
 
 	ss << std::hex;
 	ss << "digraph \"0x" << m_addr << "\" {" << std::endl;
-	ss << "  label = \"0x" << m_addr << " (" << m_functionName << ")\"" << std::endl;
+	ss << "  label = \"0x" << m_addr << " (" << m_functionName << ")"
+	   << (m_repaired ? " [repaired]" : "") << "\"" << std::endl;
     ss << "  labelloc = \"t\"" << std::endl;
     ss << "  node[shape=record]" << std::endl;
     ss << std::endl;
 
 	for (CfgNode* node : m_nodes) {
+		if (hot && hot->region(node) >= 0)
+			continue;
+
 		switch (node->type()) {
 			case CfgNode::CFG_ENTRY:
 			    ss << "  Entry [label=\"\",width=0.3,height=0.3,shape=circle,fillcolor=black,style=filled]" << std::endl;
@@ -366,7 +524,27 @@ std::string CFG::toDOT() const {
 		}
 	}
 
+	if (hot) {
+		for (std::vector<HotSubgraph::Region>::size_type i = 0; i < hot->regions().size(); i++) {
+			const HotSubgraph::Region& region = hot->regions()[i];
+			ss << "  \"Cold" << std::dec << i << "\" [label=\"{" << std::endl;
+			ss << "    " << region.blocks << " cold blocks\\l" << std::endl;
+			ss << "    | 0x" << std::hex << region.first << " - 0x" << region.last << "\\l" << std::endl;
+			ss << "    | count: " << std::dec << region.count << "\\l" << std::endl;
+			ss << "  }\", style=filled, fillcolor=lightgray]" << std::endl;
+		}
+	}
+
+	// Edges into and out of the cold regions are aggregated.
+	std::map<std::pair<std::string, std::string>, unsigned long long> collapsed;
 	for (CfgEdge* edge : m_edges) {
+		if (hot && (hot->region(edge->source()) >= 0 || hot->region(edge->destination()) >= 0)) {
+			if (hot->region(edge->source()) != hot->region(edge->destination()))
+				collapsed[std::make_pair(dotName(edge->source(), hot),
+					dotName(edge->destination(), hot))] += edge->count();
+			continue;
+		}
+
 		ss << std::hex;
 
 		CfgNode* src = edge->source();
@@ -407,42 +585,26 @@ std::string CFG::toDOT() const {
 		ss << std::endl;
 	}
 
+	for (std::map<std::pair<std::string, std::string>, unsigned long long>::const_iterator
+			it = collapsed.cbegin(), ed = collapsed.cend(); it != ed; ++it) {
+		ss << "  " << it->first.first << " -> " << it->first.second
+		   << std::dec << " [label=\" " << it->second << "\", style=bold]" << std::endl;
+	}
+
 	ss << "}" << std::endl;
 
 	return ss.str();
 }
 
-void CFG::dumpDOT(const std::string& fileName) {
+void CFG::dumpDOT(const std::string& fileName, const HotSubgraph* hot) {
 	std::ofstream fout(fileName);
 	if (!fout.is_open())
 		throw std::string("Unable to write file: ") + fileName;
 
-	fout << this->toDOT();
+	fout << this->toDOT(hot);
 	fout.close();
 }
 
-static
-std::string node2name(CfgNode* node) {
-	assert(node != 0);
-	switch (node->type()) {
-		case CfgNode::CFG_ENTRY:
-			return "entry";
-		case CfgNode::CFG_PHANTOM:
-		case CfgNode::CFG_BLOCK: {
-			std::stringstream ss;
-			ss << std::hex << "0x" << CfgNode::node2addr(node);
-			return ss.str();
-			} break;
-		case CfgNode::CFG_EXIT:
-			return "exit";
-		case CfgNode::CFG_HALT:
-			return "halt";
-		default:
-			assert(false);
-	}
-	return "";
-}
-
 std::string CFG::str() const {
 	std::stringstream ss;
 
@@ -451,13 +613,19 @@ std::string CFG::str() const {
 		ss << std::dec << ":" << this->execs();
 
 	ss << " \"" << this->functionName()
-	   << "\" " << (this->complete() ? "true" : "false") << "]" << std::endl;
-	for (CfgNode* node : this->nodes()) {
+	   << "\" " << (this->complete() ? "true" : "false");
+	if (this->repaired())
+		ss << " repaired";
+	ss << "]" << std::endl;
+	for (std::map<Addr, CfgNode*>::const_iterator it = m_nodesMap.cbegin(),
+			ed = m_nodesMap.cend(); it != ed; ++it) {
+		CfgNode* node = it->second;
+
 		// Only output block nodes.
 		if (node->type() != CfgNode::CFG_BLOCK)
 			continue;
 
-		ss << std::hex << "[node 0x" << this->addr() << " " << node2name(node);
+		ss << std::hex << "[node 0x" << this->addr() << " " << CfgNode::node2name(node);
 
 		CfgNode::BlockData* data = static_cast<CfgNode::BlockData*>(node->data());
 		assert(data != 0);
@@ -476,10 +644,14 @@ std::string CFG::str() const {
 		ss << "]";
 
 		ss << " [";
-		const std::set<CfgCall*>& calls = data->calls();
-		for (std::set<CfgCall*>::const_iterator it = calls.cbegin(),
+		const std::set<CfgCall*>& callsSet = data->calls();
+		std::vector<CfgCall*> calls(callsSet.cbegin(), callsSet.cend());
+		std::sort(calls.begin(), calls.end(), [](CfgCall* c1, CfgCall* c2) {
+			return c1->called()->addr() < c2->called()->addr();
+		});
+		for (std::vector<CfgCall*>::const_iterator it = calls.cbegin(),
 				ed = calls.cend(); it != ed; ++it) {
-			if (it != calls.begin())
+			if (it != calls.cbegin())
 				ss << " ";
 
 			CFG* called = (*it)->called();
@@ -492,10 +664,16 @@ std::string CFG::str() const {
 		ss << "]";
 
 		ss << " [";
-		const std::set<CfgSignalHandler*>& signalHandlers = data->signalHandlers();
-		for (std::set<CfgSignalHandler*>::const_iterator it = signalHandlers.cbegin(),
+		const std::set<CfgSignalHandler*>& signalHandlersSet = data->signalHandlers();
+		std::vector<CfgSignalHandler*> signalHandlers(signalHandlersSet.cbegin(),
+			signalHandlersSet.cend());
+		std::sort(signalHandlers.begin(), signalHandlers.end(),
+			[](CfgSignalHandler* s1, CfgSignalHandler* s2) {
+				return s1->sigid() < s2->sigid();
+			});
+		for (std::vector<CfgSignalHandler*>::const_iterator it = signalHandlers.cbegin(),
 				ed = signalHandlers.cend(); it != ed; ++it) {
-			if (it != signalHandlers.begin())
+			if (it != signalHandlers.cbegin())
 				ss << " ";
 
 			int sigid = (*it)->sigid();
@@ -512,14 +690,16 @@ std::string CFG::str() const {
 		ss << " " << (data->indirect() ? "true" : "false");
 
 		ss << " [";
-		const std::set<CfgNode*>& succs = this->successors(node);
-		for (std::set<CfgNode*>::const_iterator it = succs.cbegin(),
+		std::vector<CfgNode*> succs(this->successors(node).cbegin(),
+			this->successors(node).cend());
+		std::sort(succs.begin(), succs.end(), CfgNode::nodeOrder);
+		for (std::vector<CfgNode*>::const_iterator it = succs.cbegin(),
 				ed = succs.cend(); it != ed; ++it) {
 			if (it != succs.cbegin())
 				ss << " ";
 
 			CfgNode* succ = *it;
-			ss << node2name(succ);
+			ss << CfgNode::node2name(succ);
 
 			CfgEdge* edge = this->findEdge(node, succ);
 			assert(edge != 0);
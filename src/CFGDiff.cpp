@@ -0,0 +1,313 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#include <cassert>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <unordered_map>
+
+#include <CFG.h>
+#include <CfgEdge.h>
+#include <CfgNode.h>
+#include <CFGDiff.h>
+#include <CFGReader.h>
+#include <ThreadPool.h>
+
+typedef std::pair<CFGDiff::NodeKey, CFGDiff::NodeKey> PairKey;
+
+struct PairKeyHash {
+	std::size_t operator()(const PairKey& key) const {
+		std::size_t h = std::hash<Addr>()(key.first.second);
+		h = h * 31 + std::hash<Addr>()(key.second.second);
+		h = h * 31 + key.first.first;
+		return h * 31 + key.second.first;
+	}
+};
+
+typedef std::unordered_map<PairKey, unsigned long long, PairKeyHash> CountMap;
+
+static
+CFGDiff::NodeKey nodeKey(CfgNode* node) {
+	CfgNode::Type type = node->type();
+	if (type == CfgNode::CFG_PHANTOM)
+		type = CfgNode::CFG_BLOCK;
+
+	return std::make_pair(type, CfgNode::node2addr(node));
+}
+
+static
+CFGDiff::NodeKey blockKey(Addr addr) {
+	return std::make_pair(CfgNode::CFG_BLOCK, addr);
+}
+
+static
+void collectCounts(const CFG* cfg, CountMap& blocks, CountMap& edges, CountMap& calls) {
+	if (!cfg)
+		return;
+
+	for (CfgEdge* edge : cfg->edges()) {
+		CFGDiff::NodeKey src = nodeKey(edge->source());
+		CFGDiff::NodeKey dst = nodeKey(edge->destination());
+		edges[std::make_pair(src, dst)] += edge->count();
+
+		// Only real blocks, phantoms were never executed.
+		if (edge->destination()->type() == CfgNode::CFG_BLOCK)
+			blocks[std::make_pair(dst, dst)] += edge->count();
+	}
+
+	for (CfgNode* node : cfg->nodes()) {
+		if (node->type() != CfgNode::CFG_BLOCK)
+			continue;
+
+		CfgNode::BlockData* data = static_cast<CfgNode::BlockData*>(node->data());
+		assert(data != 0);
+
+		// Make sure blocks without predecessors are also present.
+		blocks[std::make_pair(nodeKey(node), nodeKey(node))];
+
+		for (CfgCall* call : data->calls()) {
+			calls[std::make_pair(blockKey(data->addr()),
+				blockKey(call->called()->addr()))] += call->count();
+		}
+	}
+}
+
+static
+void joinCounts(CFGDiff::Change::Kind kind, const CFGDiff::Change& base,
+		const CountMap& before, CountMap& after, std::vector<CFGDiff::Change>& changes) {
+	CFGDiff::Change change = base;
+	change.kind = kind;
+
+	for (CountMap::const_iterator it = before.cbegin(), ed = before.cend();
+			it != ed; ++it) {
+		change.src = it->first.first;
+		change.dst = it->first.second;
+		change.inBefore = true;
+		change.before = it->second;
+
+		CountMap::iterator match = after.find(it->first);
+		if (match != after.end()) {
+			change.inAfter = true;
+			change.after = match->second;
+			after.erase(match);
+
+			if (change.before == change.after)
+				continue;
+		} else {
+			change.inAfter = false;
+			change.after = 0;
+		}
+
+		changes.push_back(change);
+	}
+
+	for (CountMap::const_iterator it = after.cbegin(), ed = after.cend();
+			it != ed; ++it) {
+		change.src = it->first.first;
+		change.dst = it->first.second;
+		change.inBefore = false;
+		change.before = 0;
+		change.inAfter = true;
+		change.after = it->second;
+
+		changes.push_back(change);
+	}
+}
+
+CFGDiff::CFGDiff(unsigned jobs) : m_jobs(jobs) {
+}
+
+CFGDiff::~CFGDiff() {
+}
+
+void CFGDiff::compareCFGs(const CFG* before, const CFG* after,
+		std::vector<Change>& changes) {
+	assert(before != 0 || after != 0);
+
+	Change base;
+	base.faddr = (before ? before->addr() : after->addr());
+	base.name = (after && (!before || after->functionName() != "unknown") ?
+		after->functionName() : before->functionName());
+
+	Change function = base;
+	function.kind = Change::FUNCTION;
+	function.src = function.dst = blockKey(base.faddr);
+	function.inBefore = (before != 0);
+	function.before = (before ? before->execs() : 0);
+	function.inAfter = (after != 0);
+	function.after = (after ? after->execs() : 0);
+	if (!function.inBefore || !function.inAfter || function.before != function.after)
+		changes.push_back(function);
+
+	CountMap blocks[2], edges[2], calls[2];
+	collectCounts(before, blocks[0], edges[0], calls[0]);
+	collectCounts(after, blocks[1], edges[1], calls[1]);
+
+	joinCounts(Change::BLOCK, base, blocks[0], blocks[1], changes);
+	joinCounts(Change::EDGE, base, edges[0], edges[1], changes);
+	joinCounts(Change::CALL, base, calls[0], calls[1], changes);
+}
+
+void CFGDiff::compare(const CFGReader& before, const CFGReader& after,
+		const std::function<bool(Addr)>& filter) {
+	std::unordered_map<Addr, CFG*> afterCFGs;
+	for (CFG* cfg : after.cfgs())
+		afterCFGs[cfg->addr()] = cfg;
+
+	std::vector<std::pair<CFG*, CFG*>> pairs;
+	for (CFG* cfg : before.cfgs()) {
+		std::unordered_map<Addr, CFG*>::iterator it = afterCFGs.find(cfg->addr());
+		if (it != afterCFGs.end()) {
+			pairs.push_back(std::make_pair(cfg, it->second));
+			afterCFGs.erase(it);
+		} else {
+			pairs.push_back(std::make_pair(cfg, (CFG*) 0));
+		}
+	}
+
+	for (std::unordered_map<Addr, CFG*>::const_iterator it = afterCFGs.cbegin(),
+			ed = afterCFGs.cend(); it != ed; ++it)
+		pairs.push_back(std::make_pair((CFG*) 0, it->second));
+
+	// Compare the functions in parallel, each one into its own list.
+	std::vector<std::vector<Change>> results(pairs.size());
+	ThreadPool pool(m_jobs);
+	for (std::vector<std::pair<CFG*, CFG*>>::size_type i = 0; i < pairs.size(); i++) {
+		Addr addr = (pairs[i].first ? pairs[i].first : pairs[i].second)->addr();
+		if (filter && !filter(addr))
+			continue;
+
+		const std::pair<CFG*, CFG*>& pair = pairs[i];
+		std::vector<Change>& result = results[i];
+		pool.submit([&pair, &result] {
+			CFGDiff::compareCFGs(pair.first, pair.second, result);
+		});
+	}
+	pool.wait();
+
+	m_changes.clear();
+	for (std::vector<Change>& result : results)
+		m_changes.insert(m_changes.end(), result.cbegin(), result.cend());
+
+	std::sort(m_changes.begin(), m_changes.end(), [](const Change& c1, const Change& c2) {
+		if (c1.impact() != c2.impact())
+			return c1.impact() > c2.impact();
+		if (c1.faddr != c2.faddr)
+			return c1.faddr < c2.faddr;
+		if (c1.kind != c2.kind)
+			return c1.kind < c2.kind;
+		if (c1.src != c2.src)
+			return c1.src < c2.src;
+		return c1.dst < c2.dst;
+	});
+}
+
+static
+std::string key2name(const CFGDiff::NodeKey& key) {
+	switch (key.first) {
+		case CfgNode::CFG_ENTRY:
+			return "entry";
+		case CfgNode::CFG_EXIT:
+			return "exit";
+		case CfgNode::CFG_HALT:
+			return "halt";
+		default: {
+			std::stringstream ss;
+			ss << std::hex << "0x" << key.second;
+			return ss.str();
+		}
+	}
+}
+
+std::string CFGDiff::str() const {
+	std::stringstream ss;
+
+	for (const Change& change : m_changes) {
+		switch (change.kind) {
+			case Change::FUNCTION:
+				ss << "function";
+				break;
+			case Change::BLOCK:
+				ss << "block";
+				break;
+			case Change::EDGE:
+				ss << "edge";
+				break;
+			case Change::CALL:
+				ss << "call";
+				break;
+			default:
+				assert(false);
+		}
+
+		ss << std::hex << " 0x" << change.faddr << " \"" << change.name << "\"";
+		switch (change.kind) {
+			case Change::BLOCK:
+				ss << " " << key2name(change.src);
+				break;
+			case Change::EDGE:
+			case Change::CALL:
+				ss << " " << key2name(change.src) << "->" << key2name(change.dst);
+				break;
+			default:
+				break;
+		}
+
+		ss << std::dec << ": ";
+		if (change.inBefore)
+			ss << change.before;
+		else
+			ss << "-";
+
+		ss << " -> ";
+		if (change.inAfter)
+			ss << change.after;
+		else
+			ss << "-";
+
+		ss << " (";
+		if (change.impact() > 0)
+			ss << (change.after > change.before ? "+" : "-");
+		ss << change.impact() << ", ";
+		if (!change.inBefore)
+			ss << "added";
+		else if (!change.inAfter)
+			ss << "removed";
+		else if (change.before == 0)
+			ss << "inf";
+		else
+			ss << std::showpos << std::fixed << std::setprecision(2)
+			   << (100.0 * ((double) change.after - (double) change.before) / change.before)
+			   << "%" << std::noshowpos;
+
+		ss << ")" << std::endl;
+	}
+
+	return ss.str();
+}
+
+std::ostream& operator<<(std::ostream& os, const CFGDiff& diff) {
+	os << diff.str();
+	return os;
+}
@@ -0,0 +1,257 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <algorithm>
+#include <unistd.h>
+#include <CFGGrindMerger.h>
+
+CFGGrindMerger::CFGGrindMerger(const std::list<std::string>& inputs) {
+	m_inputs.reserve(inputs.size());
+	for (const std::string& filename : inputs) {
+		Input input;
+		input.stream = new CFGGrindStream(filename);
+		m_inputs.push_back(input);
+
+		Input& last = m_inputs.back();
+		if (last.stream->nextRecord(last.record))
+			m_heap.push(std::make_pair(last.record.faddr, m_inputs.size() - 1));
+	}
+}
+
+CFGGrindMerger::~CFGGrindMerger() {
+	for (Input& input : m_inputs)
+		delete input.stream;
+}
+
+bool CFGGrindMerger::nextGroup(Group& group) {
+	group.clear();
+	if (m_heap.empty())
+		return false;
+
+	// Take every input positioned at the lowest function address,
+	// keeping them in input order.
+	Addr addr = m_heap.top().first;
+	std::vector<std::vector<Input>::size_type> selected;
+	while (!m_heap.empty() && m_heap.top().first == addr) {
+		selected.push_back(m_heap.top().second);
+		m_heap.pop();
+	}
+	std::sort(selected.begin(), selected.end());
+
+	for (std::vector<Input>::size_type idx : selected) {
+		Input& input = m_inputs[idx];
+		bool more;
+		do {
+			group.push_back(std::make_pair(idx, input.record));
+			more = input.stream->nextRecord(input.record);
+		} while (more && input.record.faddr == addr);
+
+		if (more) {
+			if (input.record.faddr < addr)
+				throw std::string("Input not sorted by function address: ") +
+					input.stream->filename();
+
+			m_heap.push(std::make_pair(input.record.faddr, idx));
+		}
+	}
+
+	return true;
+}
+
+bool CFGGrindMerger::nextFunction(CFGGrindStream::Function& function) {
+	Group group;
+	if (!this->nextGroup(group))
+		return false;
+
+	CFGGrindStream::clear(function, group.front().second.faddr);
+	for (const std::pair<unsigned, CFGGrindStream::Record>& entry : group)
+		CFGGrindStream::combine(function, entry.second);
+
+	return true;
+}
+
+void CFGGrindMerger::merge(const std::list<std::string>& inputs, std::ostream& output,
+		const std::string& tmpdir, const std::function<bool(Addr)>& filter) {
+	std::list<std::string> files(inputs);
+	std::list<std::string> temps;
+
+	// Merge in passes while there are too many files to open at once.
+	try {
+		while (files.size() > MAX_FANIN) {
+			std::list<std::string> next;
+			while (!files.empty()) {
+				std::list<std::string> chunk;
+				while (!files.empty() && chunk.size() < MAX_FANIN) {
+					chunk.push_back(files.front());
+					files.pop_front();
+				}
+
+				std::string tmp = CFGGrindMerger::tempFile(tmpdir);
+				temps.push_back(tmp);
+				next.push_back(tmp);
+
+				std::ofstream out(tmp);
+				if (!out.is_open())
+					throw std::string("Unable to write file: ") + tmp;
+
+				CFGGrindMerger::merge(chunk, out, tmpdir);
+			}
+
+			files.swap(next);
+		}
+
+		CFGGrindMerger merger(files);
+		CFGGrindStream::Function function;
+		while (merger.nextFunction(function)) {
+			if (!filter || filter(function.addr))
+				CFGGrindStream::write(output, function);
+		}
+	} catch (...) {
+		CFGGrindMerger::removeFiles(temps);
+		throw;
+	}
+
+	CFGGrindMerger::removeFiles(temps);
+}
+
+unsigned long long CFGGrindMerger::recordSize(const CFGGrindStream::Record& record) {
+	const unsigned long long entry = 48;
+	const CFGGrindStream::Node& node = record.node;
+
+	return sizeof(record) + record.name.size() +
+		node.instrs.size() * sizeof(int) +
+		(node.calls.size() + node.signalHandlers.size() + node.succs.size()) * entry;
+}
+
+typedef std::pair<Addr, CFGGrindStream::Record> RunEntry;
+
+static
+void writeRun(std::vector<RunEntry>& records, const std::string& filename) {
+	std::stable_sort(records.begin(), records.end(),
+		[](const RunEntry& r1, const RunEntry& r2) {
+			return r1.first < r2.first;
+		});
+
+	std::ofstream out(filename);
+	if (!out.is_open())
+		throw std::string("Unable to write file: ") + filename;
+
+	// Records of the same function are contiguous. References are only
+	// kept, once, for functions without records of their own.
+	std::vector<RunEntry>::const_iterator it = records.cbegin(), ed = records.cend();
+	while (it != ed) {
+		std::vector<RunEntry>::const_iterator next = it;
+		bool defined = false;
+		for (; next != ed && next->first == it->first; ++next) {
+			if (next->second.type != CFGGrindStream::Record::REF_RECORD)
+				defined = true;
+		}
+
+		if (defined) {
+			for (; it != next; ++it) {
+				if (it->second.type != CFGGrindStream::Record::REF_RECORD)
+					CFGGrindStream::write(out, it->second);
+			}
+		} else {
+			CFGGrindStream::write(out, it->second);
+			it = next;
+		}
+	}
+
+	records.clear();
+}
+
+static
+void addRef(std::vector<RunEntry>& records, Addr addr) {
+	CFGGrindStream::Record ref;
+	ref.type = CFGGrindStream::Record::REF_RECORD;
+	ref.faddr = addr;
+
+	records.push_back(std::make_pair(addr, ref));
+}
+
+std::list<std::string> CFGGrindMerger::sortRuns(const std::string& input,
+		unsigned long long budget, const std::string& tmpdir, bool refs) {
+	std::list<std::string> runs;
+	std::vector<RunEntry> records;
+	unsigned long long used = 0;
+
+	try {
+		CFGGrindStream stream(input);
+		CFGGrindStream::Record record;
+		while (stream.nextRecord(record)) {
+			used += CFGGrindMerger::recordSize(record);
+			records.push_back(std::make_pair(record.faddr, record));
+
+			if (refs && record.type == CFGGrindStream::Record::NODE_RECORD) {
+				for (const std::pair<const Addr, unsigned long long>& call : record.node.calls)
+					addRef(records, call.first);
+
+				for (const std::pair<const int, std::pair<Addr, unsigned long long>>& handler :
+						record.node.signalHandlers)
+					addRef(records, handler.second.first);
+
+				used += (record.node.calls.size() + record.node.signalHandlers.size()) *
+					sizeof(RunEntry);
+			}
+
+			if (used >= budget) {
+				runs.push_back(CFGGrindMerger::tempFile(tmpdir));
+				writeRun(records, runs.back());
+				used = 0;
+			}
+		}
+
+		if (!records.empty()) {
+			runs.push_back(CFGGrindMerger::tempFile(tmpdir));
+			writeRun(records, runs.back());
+		}
+	} catch (...) {
+		CFGGrindMerger::removeFiles(runs);
+		throw;
+	}
+
+	return runs;
+}
+
+std::string CFGGrindMerger::tempFile(const std::string& tmpdir) {
+	std::string tmpl = tmpdir + "/cfgconv-XXXXXX";
+	std::vector<char> name(tmpl.cbegin(), tmpl.cend());
+	name.push_back('\0');
+
+	int fd = mkstemp(name.data());
+	if (fd < 0)
+		throw std::string("Unable to create temporary file in: ") + tmpdir;
+
+	close(fd);
+	return std::string(name.data());
+}
+
+void CFGGrindMerger::removeFiles(const std::list<std::string>& files) {
+	for (const std::string& file : files)
+		std::remove(file.c_str());
+}
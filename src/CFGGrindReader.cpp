@@ -20,7 +20,7 @@
    The GNU General Public License is contained in the file COPYING.
 */
 
-#include <cassert>
+#include <sstream>
 #include <CFG.h>
 #include <CfgNode.h>
 #include <CFGGrindReader.h>
@@ -29,10 +29,17 @@ CFGGrindReader::CFGGrindReader(const std::string& filename)
 	: CFGReader(filename), m_tokens(m_input), m_current(m_tokens.nextToken()) {
 }
 
+CFGGrindReader::CFGGrindReader(std::istream* input)
+	: CFGReader(input), m_tokens(m_input), m_current(m_tokens.nextToken()) {
+}
+
 CFGGrindReader::~CFGGrindReader() {
 }
 
 void CFGGrindReader::loadCFGs() {
+	// The CFGs are built while the records are parsed.
+	this->startPhases();
+
 	while (m_current.type == InputTokenizer::Lexeme::TKN_BRACKET_OPEN) {
 		matchToken(InputTokenizer::Lexeme::TKN_BRACKET_OPEN);
 
@@ -56,9 +63,21 @@ void CFGGrindReader::loadCFGs() {
 
 			matchToken(InputTokenizer::Lexeme::TKN_BOOL);
 
+			// Counts adjusted by FlowRepair.
+			bool repaired = false;
+			if (m_current.type == InputTokenizer::Lexeme::TKN_KEYWORD) {
+				if (m_current.token != "repaired")
+					throw std::string("Invalid cfg flag: ") + m_current.token;
+
+				matchToken(InputTokenizer::Lexeme::TKN_KEYWORD);
+				repaired = true;
+			}
+
 			CFG* cfg = this->instance(addr);
 			cfg->setFunctionName(fname);
 			cfg->updateExecs(execs);
+			if (repaired)
+				cfg->setRepaired();
 		} else if (keyword == "node") {
 			Addr faddr = m_current.data.addr;
 			matchToken(InputTokenizer::Lexeme::TKN_ADDR);
@@ -69,18 +88,23 @@ void CFGGrindReader::loadCFGs() {
 			matchToken(InputTokenizer::Lexeme::TKN_ADDR);
 
 			CfgNode* node = cfg->nodeByAddr(baddr);
-			CfgNode::BlockData* data = new CfgNode::BlockData(baddr);
 			if (node == 0) {
 				node = new CfgNode(CfgNode::CFG_BLOCK);
-				node->setData(data);
+				node->setData(new CfgNode::BlockData(baddr));
 				cfg->addNode(node);
 			} else {
-				assert(node->type() == CfgNode::CFG_PHANTOM);
-				node->setData(data);
+				cfg->promotePhantom(node);
 			}
 
+			CfgNode::BlockData* data = static_cast<CfgNode::BlockData*>(node->data());
+
 			if (baddr == cfg->addr()) {
-				assert(cfg->entryNode() == 0);
+				if (cfg->entryNode() != 0) {
+					std::stringstream ss;
+					ss << "Duplicated entry node 0x" << std::hex << baddr;
+					throw ss.str();
+				}
+
 				CfgNode* entry = CFGReader::entryNode(cfg);
 				cfg->addEdge(entry, node, cfg->execs());
 			}
@@ -101,7 +125,11 @@ void CFGGrindReader::loadCFGs() {
 			}
 			matchToken(InputTokenizer::Lexeme::TKN_BRACKET_CLOSE);
 
-			assert(bsize == data->size());
+			if (bsize != data->size()) {
+				std::stringstream ss;
+				ss << "Mismatched size of node 0x" << std::hex << baddr;
+				throw ss.str();
+			}
 
 			matchToken(InputTokenizer::Lexeme::TKN_BRACKET_OPEN);
 			while (m_current.type != InputTokenizer::Lexeme::TKN_BRACKET_CLOSE) {
@@ -170,14 +198,12 @@ void CFGGrindReader::loadCFGs() {
 							dst = CFGReader::exitNode(cfg);
 						else if (keyword == "halt")
 							dst = CFGReader::haltNode(cfg);
-						else {
-							// std::cout << keyword << std::endl;
-							assert(false);
-						}
+						else
+							throw std::string("Invalid successor: ") + keyword;
 
 						break;
 					default:
-						assert(false);
+						throw std::string("Invalid cfggrind format near: ") + m_current.token;
 				}
 
 				unsigned long long count = 0;
@@ -192,19 +218,27 @@ void CFGGrindReader::loadCFGs() {
 			}
 			matchToken(InputTokenizer::Lexeme::TKN_BRACKET_CLOSE);
 		} else {
-			assert(false);
+			throw std::string("Invalid record: ") + keyword;
 		}
 
 		matchToken(InputTokenizer::Lexeme::TKN_BRACKET_CLOSE);
 	}
 
 	matchToken(InputTokenizer::Lexeme::TKN_EOF);
+	this->endPhase("build");
 
-	for (CFG* cfg : this->cfgs())
-		cfg->check();
+	this->checkCFGs();
+	this->endPhase("check");
 }
 
 void CFGGrindReader::matchToken(InputTokenizer::Lexeme::Type type) {
-	assert(m_current.type == type);
+	if (m_current.type != type) {
+		if (m_current.type == InputTokenizer::Lexeme::TKN_EOF ||
+				m_current.type == InputTokenizer::Lexeme::TKN_UNEXPECTED_EOF)
+			throw std::string("Unexpected end of cfggrind input");
+
+		throw std::string("Invalid cfggrind format near: ") + m_current.token;
+	}
+
 	m_current = m_tokens.nextToken();
 }
@@ -0,0 +1,428 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#include <set>
+#include <cassert>
+#include <CFG.h>
+#include <CFGGrindStream.h>
+
+CFGGrindStream::CFGGrindStream(const std::string& filename)
+	: m_filename(filename), m_tokens(m_input) {
+	m_input.open(filename, std::fstream::in);
+	if (!m_input.is_open())
+		throw std::string("Unable to open file: ") + filename;
+
+	m_current = m_tokens.nextToken();
+}
+
+CFGGrindStream::~CFGGrindStream() {
+	m_input.close();
+}
+
+bool CFGGrindStream::nextRecord(Record& record) {
+	if (m_current.type != InputTokenizer::Lexeme::TKN_BRACKET_OPEN) {
+		matchToken(InputTokenizer::Lexeme::TKN_EOF);
+		return false;
+	}
+
+	matchToken(InputTokenizer::Lexeme::TKN_BRACKET_OPEN);
+
+	std::string keyword = m_current.token;
+	matchToken(InputTokenizer::Lexeme::TKN_KEYWORD);
+
+	if (keyword == "cfg")
+		this->readCfg(record);
+	else if (keyword == "node")
+		this->readNode(record);
+	else if (keyword == "ref") {
+		record.type = Record::REF_RECORD;
+
+		record.faddr = m_current.data.addr;
+		matchToken(InputTokenizer::Lexeme::TKN_ADDR);
+	} else
+		throw std::string("Invalid record \"") + keyword + "\" in file: " + m_filename;
+
+	matchToken(InputTokenizer::Lexeme::TKN_BRACKET_CLOSE);
+
+	return true;
+}
+
+void CFGGrindStream::readCfg(Record& record) {
+	record.type = Record::CFG_RECORD;
+
+	record.faddr = m_current.data.addr;
+	matchToken(InputTokenizer::Lexeme::TKN_ADDR);
+
+	record.execs = this->readCount();
+
+	record.name = m_current.token;
+	matchToken(InputTokenizer::Lexeme::TKN_STRING);
+
+	record.complete = m_current.data.boolean;
+	matchToken(InputTokenizer::Lexeme::TKN_BOOL);
+
+	record.repaired = false;
+	if (m_current.type == InputTokenizer::Lexeme::TKN_KEYWORD) {
+		if (m_current.token != "repaired")
+			throw std::string("Invalid cfg flag \"") + m_current.token + "\" in file: " + m_filename;
+
+		matchToken(InputTokenizer::Lexeme::TKN_KEYWORD);
+		record.repaired = true;
+	}
+}
+
+void CFGGrindStream::readNode(Record& record) {
+	record.type = Record::NODE_RECORD;
+
+	record.faddr = m_current.data.addr;
+	matchToken(InputTokenizer::Lexeme::TKN_ADDR);
+
+	Node& node = record.node;
+	node.addr = m_current.data.addr;
+	matchToken(InputTokenizer::Lexeme::TKN_ADDR);
+
+	node.size = m_current.data.number;
+	matchToken(InputTokenizer::Lexeme::TKN_NUMBER);
+
+	node.instrs.clear();
+	matchToken(InputTokenizer::Lexeme::TKN_BRACKET_OPEN);
+	while (m_current.type != InputTokenizer::Lexeme::TKN_BRACKET_CLOSE) {
+		node.instrs.push_back(m_current.data.number);
+		matchToken(InputTokenizer::Lexeme::TKN_NUMBER);
+	}
+	matchToken(InputTokenizer::Lexeme::TKN_BRACKET_CLOSE);
+
+	node.calls.clear();
+	matchToken(InputTokenizer::Lexeme::TKN_BRACKET_OPEN);
+	while (m_current.type != InputTokenizer::Lexeme::TKN_BRACKET_CLOSE) {
+		Addr caddr = m_current.data.addr;
+		matchToken(InputTokenizer::Lexeme::TKN_ADDR);
+
+		node.calls[caddr] += this->readCount();
+	}
+	matchToken(InputTokenizer::Lexeme::TKN_BRACKET_CLOSE);
+
+	node.signalHandlers.clear();
+	matchToken(InputTokenizer::Lexeme::TKN_BRACKET_OPEN);
+	while (m_current.type != InputTokenizer::Lexeme::TKN_BRACKET_CLOSE) {
+		int sigid = m_current.data.number;
+		matchToken(InputTokenizer::Lexeme::TKN_NUMBER);
+
+		matchToken(InputTokenizer::Lexeme::TKN_ARROW);
+
+		Addr saddr = m_current.data.addr;
+		matchToken(InputTokenizer::Lexeme::TKN_ADDR);
+
+		unsigned long long count = this->readCount();
+		node.signalHandlers[sigid] = std::make_pair(saddr, count);
+	}
+	matchToken(InputTokenizer::Lexeme::TKN_BRACKET_CLOSE);
+
+	node.indirect = m_current.data.boolean;
+	matchToken(InputTokenizer::Lexeme::TKN_BOOL);
+
+	node.succs.clear();
+	node.exit = node.halt = false;
+	node.exitCount = node.haltCount = 0;
+	matchToken(InputTokenizer::Lexeme::TKN_BRACKET_OPEN);
+	while (m_current.type != InputTokenizer::Lexeme::TKN_BRACKET_CLOSE) {
+		if (m_current.type == InputTokenizer::Lexeme::TKN_ADDR) {
+			Addr saddr = m_current.data.addr;
+			matchToken(InputTokenizer::Lexeme::TKN_ADDR);
+
+			node.succs[saddr] += this->readCount();
+		} else {
+			std::string keyword = m_current.token;
+			matchToken(InputTokenizer::Lexeme::TKN_KEYWORD);
+
+			if (keyword == "exit") {
+				node.exit = true;
+				node.exitCount += this->readCount();
+			} else if (keyword == "halt") {
+				node.halt = true;
+				node.haltCount += this->readCount();
+			} else
+				throw std::string("Invalid successor \"") + keyword + "\" in file: " + m_filename;
+		}
+	}
+	matchToken(InputTokenizer::Lexeme::TKN_BRACKET_CLOSE);
+}
+
+unsigned long long CFGGrindStream::readCount() {
+	unsigned long long count = 0;
+	if (m_current.type == InputTokenizer::Lexeme::TKN_COLON) {
+		matchToken(InputTokenizer::Lexeme::TKN_COLON);
+
+		count = m_current.data.number;
+		matchToken(InputTokenizer::Lexeme::TKN_NUMBER);
+	}
+
+	return count;
+}
+
+void CFGGrindStream::matchToken(InputTokenizer::Lexeme::Type type) {
+	if (m_current.type != type)
+		throw std::string("Invalid cfggrind format in file: ") + m_filename;
+
+	m_current = m_tokens.nextToken();
+}
+
+static
+void writeNode(std::ostream& os, Addr faddr, const CFGGrindStream::Node& node) {
+	os << std::hex << "[node 0x" << faddr << " 0x" << node.addr;
+	os << std::dec << " " << node.size;
+
+	os << " [";
+	for (std::vector<int>::const_iterator it = node.instrs.cbegin(),
+			ed = node.instrs.cend(); it != ed; ++it) {
+		if (it != node.instrs.cbegin())
+			os << " ";
+
+		os << *it;
+	}
+	os << "]";
+
+	os << " [";
+	for (std::map<Addr, unsigned long long>::const_iterator it = node.calls.cbegin(),
+			ed = node.calls.cend(); it != ed; ++it) {
+		if (it != node.calls.cbegin())
+			os << " ";
+
+		os << std::hex << "0x" << it->first;
+		if (it->second > 0)
+			os << std::dec << ":" << it->second;
+	}
+	os << "]";
+
+	os << " [";
+	for (std::map<int, std::pair<Addr, unsigned long long>>::const_iterator
+			it = node.signalHandlers.cbegin(), ed = node.signalHandlers.cend();
+			it != ed; ++it) {
+		if (it != node.signalHandlers.cbegin())
+			os << " ";
+
+		os << std::dec << it->first << "->";
+		os << std::hex << "0x" << it->second.first;
+		if (it->second.second > 0)
+			os << std::dec << ":" << it->second.second;
+	}
+	os << "]";
+
+	os << " " << (node.indirect ? "true" : "false");
+
+	os << " [";
+	bool first = true;
+	for (std::map<Addr, unsigned long long>::const_iterator it = node.succs.cbegin(),
+			ed = node.succs.cend(); it != ed; ++it) {
+		if (!first)
+			os << " ";
+
+		os << std::hex << "0x" << it->first;
+		if (it->second > 0)
+			os << std::dec << ":" << it->second;
+
+		first = false;
+	}
+
+	if (node.exit) {
+		if (!first)
+			os << " ";
+
+		os << "exit";
+		if (node.exitCount > 0)
+			os << std::dec << ":" << node.exitCount;
+
+		first = false;
+	}
+
+	if (node.halt) {
+		if (!first)
+			os << " ";
+
+		os << "halt";
+		if (node.haltCount > 0)
+			os << std::dec << ":" << node.haltCount;
+	}
+	os << "]]" << std::endl;
+}
+
+static
+void writeCfg(std::ostream& os, Addr addr, unsigned long long execs,
+		const std::string& name, bool complete, bool repaired) {
+	os << std::hex << "[cfg 0x" << addr;
+	if (execs > 0)
+		os << std::dec << ":" << execs;
+
+	os << " \"" << name << "\" " << (complete ? "true" : "false");
+	if (repaired)
+		os << " repaired";
+	os << "]" << std::endl;
+}
+
+void CFGGrindStream::write(std::ostream& os, const Record& record) {
+	switch (record.type) {
+		case Record::CFG_RECORD:
+			writeCfg(os, record.faddr, record.execs, record.name, record.complete,
+				record.repaired);
+			break;
+		case Record::NODE_RECORD:
+			writeNode(os, record.faddr, record.node);
+			break;
+		case Record::REF_RECORD:
+			os << std::hex << "[ref 0x" << record.faddr << "]" << std::endl;
+			break;
+		default:
+			assert(false);
+	}
+}
+
+// As CFG::check, with its flow rules: a function is complete when its
+// flow is valid and it has neither indirect jumps nor phantom blocks.
+static
+bool isComplete(const CFGGrindStream::Function& function) {
+	std::map<Addr, unsigned long long> inflow;
+	std::set<Addr> reached;
+	unsigned long long leaving = 0;
+	bool leaves = false;
+
+	if (function.nodes.find(function.addr) == function.nodes.end())
+		return false;
+
+	inflow[function.addr] = function.execs;
+	reached.insert(function.addr);
+
+	for (std::map<Addr, CFGGrindStream::Node>::const_iterator it = function.nodes.cbegin(),
+			ed = function.nodes.cend(); it != ed; ++it) {
+		const CFGGrindStream::Node& node = it->second;
+		for (std::map<Addr, unsigned long long>::const_iterator it2 = node.succs.cbegin(),
+				ed2 = node.succs.cend(); it2 != ed2; ++it2) {
+			inflow[it2->first] += it2->second;
+			reached.insert(it2->first);
+		}
+
+		if (node.exit || node.halt) {
+			leaves = true;
+			leaving += node.exitCount + node.haltCount;
+		}
+	}
+
+	// The reader gives the entry edge the executions.
+	if (!leaves || !CFG::validFlow(function.execs, leaving, function.execs))
+		return false;
+
+	for (std::set<Addr>::const_iterator it = reached.cbegin(),
+			ed = reached.cend(); it != ed; ++it) {
+		std::map<Addr, CFGGrindStream::Node>::const_iterator node =
+			function.nodes.find(*it);
+		// Phantom block.
+		if (node == function.nodes.cend())
+			return false;
+	}
+
+	for (std::map<Addr, CFGGrindStream::Node>::const_iterator it = function.nodes.cbegin(),
+			ed = function.nodes.cend(); it != ed; ++it) {
+		const CFGGrindStream::Node& node = it->second;
+		if (node.indirect)
+			return false;
+
+		unsigned long long outflow = node.exitCount + node.haltCount;
+		for (std::map<Addr, unsigned long long>::const_iterator it2 = node.succs.cbegin(),
+				ed2 = node.succs.cend(); it2 != ed2; ++it2)
+			outflow += it2->second;
+
+		if (!CFG::validBlock(true, reached.count(node.addr) != 0,
+				!node.succs.empty() || node.exit || node.halt,
+				inflow[node.addr], outflow))
+			return false;
+	}
+
+	return true;
+}
+
+void CFGGrindStream::write(std::ostream& os, const Function& function) {
+	writeCfg(os, function.addr, function.execs, function.name, isComplete(function),
+		function.repaired);
+	for (std::map<Addr, Node>::const_iterator it = function.nodes.cbegin(),
+			ed = function.nodes.cend(); it != ed; ++it)
+		writeNode(os, function.addr, it->second);
+}
+
+void CFGGrindStream::clear(Function& function, Addr addr) {
+	function.addr = addr;
+	function.execs = 0;
+	function.name = "unknown";
+	function.repaired = false;
+	function.nodes.clear();
+}
+
+void CFGGrindStream::combine(Function& function, const Record& record) {
+	assert(record.faddr == function.addr);
+
+	if (record.type == Record::REF_RECORD)
+		return;
+
+	if (record.type == Record::CFG_RECORD) {
+		function.execs += record.execs;
+		if (function.name == "unknown")
+			function.name = record.name;
+		function.repaired = function.repaired || record.repaired;
+		return;
+	}
+
+	const Node& node = record.node;
+	std::map<Addr, Node>::iterator it = function.nodes.find(node.addr);
+	if (it == function.nodes.end()) {
+		function.nodes[node.addr] = node;
+		return;
+	}
+
+	Node& merged = it->second;
+	if (merged.size != node.size)
+		throw std::string("Mismatched block sizes while combining profiles");
+
+	for (std::map<Addr, unsigned long long>::const_iterator it = node.calls.cbegin(),
+			ed = node.calls.cend(); it != ed; ++it)
+		merged.calls[it->first] += it->second;
+
+	for (std::map<int, std::pair<Addr, unsigned long long>>::const_iterator
+			it = node.signalHandlers.cbegin(), ed = node.signalHandlers.cend();
+			it != ed; ++it) {
+		std::map<int, std::pair<Addr, unsigned long long>>::iterator handler =
+			merged.signalHandlers.find(it->first);
+		if (handler == merged.signalHandlers.end())
+			merged.signalHandlers[it->first] = it->second;
+		else
+			handler->second.second += it->second.second;
+	}
+
+	merged.indirect = merged.indirect || node.indirect;
+
+	for (std::map<Addr, unsigned long long>::const_iterator it = node.succs.cbegin(),
+			ed = node.succs.cend(); it != ed; ++it)
+		merged.succs[it->first] += it->second;
+
+	merged.exit = merged.exit || node.exit;
+	merged.exitCount += node.exitCount;
+	merged.halt = merged.halt || node.halt;
+	merged.haltCount += node.haltCount;
+}
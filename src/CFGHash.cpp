@@ -0,0 +1,105 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#include <set>
+#include <cassert>
+#include <algorithm>
+
+#include <CFG.h>
+#include <CFGHash.h>
+#include <CfgNode.h>
+#include <Instruction.h>
+#include <CFGInstrCounts.h>
+
+CFGHash::CFGHash(const CFG* cfg) : m_cfg(cfg), m_hash(0) {
+	std::vector<CfgNode*> nodes;
+	for (CfgNode* node : cfg->nodes()) {
+		if (node->type() == CfgNode::CFG_BLOCK)
+			nodes.push_back(node);
+	}
+	std::sort(nodes.begin(), nodes.end(), CfgNode::nodeOrder);
+
+	m_hash = CFGHash::combine(m_hash, nodes.size());
+	for (CfgNode* node : nodes) {
+		CfgNode::BlockData* data = static_cast<CfgNode::BlockData*>(node->data());
+		assert(data != 0);
+
+		Block block;
+		block.addr = data->addr();
+
+		// Blocks without instructions (bftrace) only have their size.
+		block.opcodes = CFGHash::combine(0, data->size());
+		for (Instruction* instr : data->instructions()) {
+			block.opcodes = CFGHash::combine(block.opcodes, instr->size());
+			if (instr->text() != "???")
+				block.opcodes = CFGHash::combine(block.opcodes,
+					CFGHash::hash(CFGInstrCounts::mnemonic(instr->text())));
+		}
+
+		std::vector<Hash> succs;
+		for (CfgNode* succ : cfg->successors(node)) {
+			bool fallthrough = (succ->type() == CfgNode::CFG_BLOCK &&
+				CfgNode::node2addr(succ) == data->addr() + data->size());
+			succs.push_back(CFGHash::combine(succ->type(), fallthrough));
+		}
+		std::sort(succs.begin(), succs.end());
+
+		std::vector<Hash> calls;
+		for (CfgCall* call : data->calls()) {
+			const std::string& name = call->called()->functionName();
+			calls.push_back(CFGHash::hash(name != "unknown" ? name : std::string()));
+		}
+		std::sort(calls.begin(), calls.end());
+
+		Hash flow = CFGHash::combine(block.opcodes, data->indirect());
+		for (Hash succ : succs)
+			flow = CFGHash::combine(flow, succ);
+
+		block.shape = flow;
+		for (Hash call : calls)
+			block.shape = CFGHash::combine(block.shape, call);
+
+		m_blocks.push_back(block);
+		m_hash = CFGHash::combine(m_hash, flow);
+	}
+}
+
+CFGHash::~CFGHash() {
+}
+
+// FNV-1a, stable across runs and platforms.
+CFGHash::Hash CFGHash::hash(const std::string& str) {
+	Hash h = 0xcbf29ce484222325ULL;
+	for (unsigned char c : str) {
+		h ^= c;
+		h *= 0x100000001b3ULL;
+	}
+
+	return h;
+}
+
+CFGHash::Hash CFGHash::combine(Hash seed, Hash value) {
+	value *= 0x9e3779b97f4a7c15ULL;
+	value ^= value >> 32;
+	return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
@@ -0,0 +1,225 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#include <set>
+#include <cmath>
+#include <cassert>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <nlohmann/json.hpp>
+
+#include <CFG.h>
+#include <CfgEdge.h>
+#include <CfgNode.h>
+#include <CFGIndirect.h>
+#include <ThreadPool.h>
+
+using json = nlohmann::json;
+
+CFGIndirect::CFGIndirect(unsigned promotions, unsigned jobs)
+	: m_promotions(promotions), m_jobs(jobs) {
+}
+
+CFGIndirect::~CFGIndirect() {
+}
+
+static
+void summarize(CFGIndirect::Entry& entry, unsigned promotions) {
+	std::stable_sort(entry.targets.begin(), entry.targets.end(),
+		[](const CFGIndirect::Target& t1, const CFGIndirect::Target& t2) {
+			return t1.count > t2.count;
+		});
+
+	entry.count = 0;
+	for (const CFGIndirect::Target& target : entry.targets)
+		entry.count += target.count;
+
+	entry.entropy = 0;
+	entry.profit = 0;
+	for (std::vector<CFGIndirect::Target>::size_type i = 0; i < entry.targets.size(); i++) {
+		CFGIndirect::Target& target = entry.targets[i];
+		target.fraction = (entry.count > 0 ? (double) target.count / entry.count : 0);
+		if (target.fraction > 0)
+			entry.entropy -= target.fraction * std::log2(target.fraction);
+
+		if (i < promotions)
+			entry.profit += target.count;
+	}
+
+	entry.coverage = (entry.count > 0 ? (double) entry.profit / entry.count : 0);
+}
+
+void CFGIndirect::rank(const std::list<CFG*>& cfgs, unsigned limit) {
+	std::vector<CFG*> all(cfgs.cbegin(), cfgs.cend());
+
+	std::vector<std::vector<Entry>> results(all.size());
+
+	ThreadPool pool(m_jobs);
+	unsigned promotions = m_promotions;
+	for (std::vector<CFG*>::size_type i = 0; i < all.size(); i++) {
+		CFG* cfg = all[i];
+		std::vector<Entry>& result = results[i];
+		pool.submit([cfg, &result, promotions] {
+			std::vector<CfgNode*> nodes(cfg->nodes().cbegin(), cfg->nodes().cend());
+			std::sort(nodes.begin(), nodes.end(), CfgNode::nodeOrder);
+
+			for (CfgNode* node : nodes) {
+				if (node->type() != CfgNode::CFG_BLOCK)
+					continue;
+
+				CfgNode::BlockData* data = static_cast<CfgNode::BlockData*>(node->data());
+				assert(data != 0);
+				if (!data->indirect())
+					continue;
+
+				Entry entry;
+				entry.cfg = cfg;
+				entry.addr = data->addr();
+
+				std::set<CfgCall*> calls = data->calls();
+				entry.call = !calls.empty();
+				if (entry.call) {
+					for (CfgCall* call : calls) {
+						Target target = { call->called()->addr(),
+							call->called()->functionName(), call->count(), 0 };
+						entry.targets.push_back(target);
+					}
+				} else {
+					// Leaving through an exit, a halt or into unknown code
+					// is not a jump target that could be promoted.
+					for (CfgNode* succ : cfg->successors(node)) {
+						if (succ->type() != CfgNode::CFG_BLOCK)
+							continue;
+
+						CfgEdge* edge = cfg->findEdge(node, succ);
+						assert(edge != 0);
+
+						Target target = { CfgNode::node2addr(succ),
+							CfgNode::node2name(succ), edge->count(), 0 };
+						entry.targets.push_back(target);
+					}
+				}
+
+				// Keep the targets in address order on count ties.
+				std::sort(entry.targets.begin(), entry.targets.end(),
+					[](const Target& t1, const Target& t2) {
+						return t1.addr < t2.addr;
+					});
+
+				summarize(entry, promotions);
+				if (entry.count > 0)
+					result.push_back(entry);
+			}
+		});
+	}
+	pool.wait();
+
+	m_entries.clear();
+	for (std::vector<Entry>& result : results)
+		m_entries.insert(m_entries.end(), result.cbegin(), result.cend());
+
+	// The CFGs and their blocks are already in address order.
+	std::vector<Entry>::iterator middle = m_entries.end();
+	if (limit > 0 && limit < m_entries.size())
+		middle = m_entries.begin() + limit;
+
+	std::partial_sort(m_entries.begin(), middle, m_entries.end(),
+		[](const Entry& e1, const Entry& e2) {
+			if (e1.profit != e2.profit)
+				return e1.profit > e2.profit;
+			if (e1.cfg->addr() != e2.cfg->addr())
+				return e1.cfg->addr() < e2.cfg->addr();
+			return e1.addr < e2.addr;
+		});
+	m_entries.erase(middle, m_entries.end());
+}
+
+std::string CFGIndirect::str() const {
+	std::stringstream ss;
+
+	for (const Entry& entry : m_entries) {
+		ss << std::hex << "[indirect 0x" << entry.cfg->addr() << " \""
+		   << entry.cfg->functionName() << "\" 0x" << entry.addr << std::dec
+		   << " " << (entry.call ? "call" : "jump")
+		   << " count:" << entry.count
+		   << " targets:" << entry.targets.size()
+		   << std::fixed << std::setprecision(2)
+		   << " entropy:" << entry.entropy
+		   << " coverage:" << entry.coverage
+		   << " profit:" << entry.profit << " [";
+
+		for (std::vector<Target>::const_iterator it = entry.targets.cbegin(),
+				ed = entry.targets.cend(); it != ed; ++it) {
+			if (it != entry.targets.cbegin())
+				ss << " ";
+
+			if (entry.call)
+				ss << std::hex << "0x" << it->addr << std::dec << "(" << it->name << ")";
+			else
+				ss << it->name;
+			ss << ":" << it->count << "(" << it->fraction << ")";
+		}
+
+		ss << "]]" << std::endl;
+	}
+
+	return ss.str();
+}
+
+std::string CFGIndirect::toJSON() const {
+	json report = json::array();
+
+	for (const Entry& entry : m_entries) {
+		std::stringstream function, block;
+		function << std::hex << "0x" << entry.cfg->addr();
+		block << std::hex << "0x" << entry.addr;
+
+		json targets = json::array();
+		for (const Target& target : entry.targets) {
+			std::stringstream addr;
+			addr << std::hex << "0x" << target.addr;
+
+			targets.push_back({
+				{ "target", entry.call ? addr.str() : target.name },
+				{ "name", target.name },
+				{ "count", target.count },
+				{ "fraction", target.fraction }
+			});
+		}
+
+		report.push_back({
+			{ "function", function.str() },
+			{ "name", entry.cfg->functionName() },
+			{ "block", block.str() },
+			{ "kind", entry.call ? "call" : "jump" },
+			{ "count", entry.count },
+			{ "entropy", entry.entropy },
+			{ "coverage", entry.coverage },
+			{ "profit", entry.profit },
+			{ "targets", targets }
+		});
+	}
+
+	return report.dump(2);
+}
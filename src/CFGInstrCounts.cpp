@@ -0,0 +1,161 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#include <cassert>
+#include <cctype>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <nlohmann/json.hpp>
+
+#include <CFG.h>
+#include <CfgNode.h>
+#include <Instruction.h>
+#include <CFGInstrCounts.h>
+
+using json = nlohmann::json;
+
+CFGInstrCounts::CFGInstrCounts() : m_total(0) {
+}
+
+CFGInstrCounts::~CFGInstrCounts() {
+}
+
+void CFGInstrCounts::add(CFG* cfg) {
+	for (CfgNode* node : cfg->nodes()) {
+		if (node->type() != CfgNode::CFG_BLOCK)
+			continue;
+
+		CfgNode::BlockData* data = static_cast<CfgNode::BlockData*>(node->data());
+		assert(data != 0);
+
+		unsigned long long count = cfg->blockCount(node);
+
+		for (Instruction* instr : data->instructions()) {
+			m_instrs[instr->addr()] += count;
+			m_mnemonics[CFGInstrCounts::mnemonic(instr->text())] += count;
+			m_total += count;
+		}
+	}
+}
+
+std::string CFGInstrCounts::mnemonic(const std::string& text) {
+	static const char* prefixes[] = {
+		"lock", "rep", "repe", "repz", "repne", "repnz", "data16", "addr32",
+		"notrack", "bnd", "xacquire", "xrelease", 0
+	};
+
+	std::istringstream ss(text);
+	std::string word, result;
+	while (ss >> word) {
+		std::transform(word.begin(), word.end(), word.begin(), ::tolower);
+		if (!result.empty())
+			result += " ";
+		result += word;
+
+		bool prefix = false;
+		for (const char** p = prefixes; *p; p++) {
+			if (word == *p) {
+				prefix = true;
+				break;
+			}
+		}
+
+		if (!prefix)
+			break;
+	}
+
+	return result;
+}
+
+// Mnemonics sorted by decreasing count.
+static
+std::vector<std::pair<std::string, unsigned long long>> sortedMnemonics(
+		const std::map<std::string, unsigned long long>& mnemonics) {
+	std::vector<std::pair<std::string, unsigned long long>> sorted(
+		mnemonics.cbegin(), mnemonics.cend());
+	std::stable_sort(sorted.begin(), sorted.end(),
+		[](const std::pair<std::string, unsigned long long>& m1,
+				const std::pair<std::string, unsigned long long>& m2) {
+			return m1.second > m2.second;
+		});
+
+	return sorted;
+}
+
+std::string CFGInstrCounts::str() const {
+	std::stringstream ss;
+
+	ss << "[instructions]" << std::endl;
+	for (std::map<Addr, unsigned long long>::const_iterator it = m_instrs.cbegin(),
+			ed = m_instrs.cend(); it != ed; ++it) {
+		Instruction* instr = Instruction::get(it->first);
+		ss << std::hex << "0x" << it->first << " " << std::dec << it->second
+		   << " " << instr->text() << std::endl;
+	}
+
+	ss << "[mnemonics]" << std::endl;
+	for (const std::pair<std::string, unsigned long long>& mnemonic :
+			sortedMnemonics(m_mnemonics)) {
+		ss << mnemonic.first << " " << mnemonic.second;
+		if (m_total > 0)
+			ss << " (" << std::fixed << std::setprecision(2)
+			   << (100.0 * mnemonic.second / m_total) << "%)";
+		ss << std::endl;
+	}
+
+	ss << "total " << m_total << std::endl;
+
+	return ss.str();
+}
+
+std::string CFGInstrCounts::toJSON() const {
+	json report;
+
+	report["instructions"] = json::array();
+	for (std::map<Addr, unsigned long long>::const_iterator it = m_instrs.cbegin(),
+			ed = m_instrs.cend(); it != ed; ++it) {
+		std::stringstream ss;
+		ss << std::hex << "0x" << it->first;
+
+		report["instructions"].push_back({
+			{ "addr", ss.str() },
+			{ "text", Instruction::get(it->first)->text() },
+			{ "count", it->second }
+		});
+	}
+
+	report["mnemonics"] = json::array();
+	for (const std::pair<std::string, unsigned long long>& mnemonic :
+			sortedMnemonics(m_mnemonics)) {
+		report["mnemonics"].push_back({
+			{ "mnemonic", mnemonic.first },
+			{ "count", mnemonic.second }
+		});
+	}
+
+	report["total"] = m_total;
+
+	return report.dump(2);
+}
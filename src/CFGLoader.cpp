@@ -0,0 +1,118 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+#include <fstream>
+#include <sstream>
+#include <strings.h>
+
+#include <CFGLoader.h>
+#include <CFGReader.h>
+#include <BFTraceReader.h>
+#include <CFGGrindReader.h>
+#include <DCFGReader.h>
+
+CFGLoader::Format CFGLoader::format(const std::string& name) {
+	if (strcasecmp(name.c_str(), "bftrace") == 0)
+		return BFTRACE_FORMAT;
+	else if (strcasecmp(name.c_str(), "cfggrind") == 0)
+		return CFGGRIND_FORMAT;
+	else if (strcasecmp(name.c_str(), "dcfg") == 0)
+		return DCFG_FORMAT;
+	else
+		return UNDEF_FORMAT;
+}
+
+CFGReader* CFGLoader::fromFile(Format format, const std::string& filename,
+				const Options& options) {
+	return CFGLoader::loaded(CFGLoader::create(format, filename, options));
+}
+
+CFGReader* CFGLoader::fromBuffer(Format format, const std::string& buffer,
+				const Options& options) {
+	return CFGLoader::loaded(CFGLoader::create(format,
+		new std::istringstream(buffer), options));
+}
+
+CFGReader* CFGLoader::fromBuffer(Format format, const char* data,
+				size_t size, const Options& options) {
+	return CFGLoader::fromBuffer(format, std::string(data, size), options);
+}
+
+CFGReader* CFGLoader::create(Format format, const std::string& filename,
+				const Options& options) {
+	std::ifstream* input = new std::ifstream(filename);
+	if (!input->is_open()) {
+		delete input;
+		throw std::string("Unable to open file: ") + filename;
+	}
+
+	return CFGLoader::create(format, input, options);
+}
+
+void CFGLoader::load(CFGReader* reader) {
+	try {
+		reader->loadCFGs();
+	} catch (const nlohmann::json::exception& e) {
+		throw std::string("Invalid dcfg format: ") + e.what();
+	}
+}
+
+CFGReader* CFGLoader::create(Format format, std::istream* input,
+				const Options& options) {
+	CFGReader* reader;
+	switch (format) {
+		case BFTRACE_FORMAT:
+			reader = new BFTraceReader(input);
+			break;
+		case CFGGRIND_FORMAT:
+			reader = new CFGGrindReader(input);
+			break;
+		case DCFG_FORMAT: {
+			DCFGReader* dcfg = new DCFGReader(input);
+			dcfg->setUseRoutines(options.routines);
+			for (long pid : options.processes)
+				dcfg->addProcess(pid);
+			for (const std::string& image : options.images)
+				dcfg->addImage(image);
+
+			reader = dcfg;
+			}
+			break;
+		default:
+			delete input;
+			throw std::string("Invalid input format");
+	}
+
+	reader->setJobs(options.jobs);
+	return reader;
+}
+
+CFGReader* CFGLoader::loaded(CFGReader* reader) {
+	try {
+		CFGLoader::load(reader);
+	} catch (...) {
+		delete reader;
+		throw;
+	}
+
+	return reader;
+}
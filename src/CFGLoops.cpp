@@ -0,0 +1,133 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <nlohmann/json.hpp>
+
+#include <CFG.h>
+#include <CfgNode.h>
+#include <CFGLoops.h>
+#include <LoopForest.h>
+#include <ThreadPool.h>
+
+using json = nlohmann::json;
+
+CFGLoops::CFGLoops(unsigned jobs) : m_jobs(jobs) {
+}
+
+CFGLoops::~CFGLoops() {
+}
+
+void CFGLoops::rank(const std::list<CFG*>& cfgs, unsigned limit) {
+	std::vector<CFG*> all(cfgs.cbegin(), cfgs.cend());
+	std::vector<std::vector<Entry>> results(all.size());
+
+	ThreadPool pool(m_jobs);
+	for (std::vector<CFG*>::size_type i = 0; i < all.size(); i++) {
+		CFG* cfg = all[i];
+		std::vector<Entry>& result = results[i];
+		pool.submit([cfg, &result] {
+			LoopForest forest(cfg);
+			for (const LoopForest::Loop* loop : forest.loops()) {
+				Entry entry;
+				entry.cfg = cfg;
+				entry.headerAddr = CfgNode::node2addr(loop->header);
+				entry.header = CfgNode::node2name(loop->header);
+				entry.depth = loop->depth;
+				entry.reducible = loop->reducible;
+				entry.size = loop->size;
+				entry.entries = loop->entries;
+				entry.backEdges = loop->backEdges;
+				entry.tripCount = loop->tripCount();
+				entry.weight = loop->weight;
+				result.push_back(entry);
+			}
+		});
+	}
+	pool.wait();
+
+	m_entries.clear();
+	for (std::vector<Entry>& result : results)
+		m_entries.insert(m_entries.end(), result.cbegin(), result.cend());
+
+	// The CFGs and their loops are already in address order.
+	std::vector<Entry>::iterator middle = m_entries.end();
+	if (limit > 0 && limit < m_entries.size())
+		middle = m_entries.begin() + limit;
+
+	std::partial_sort(m_entries.begin(), middle, m_entries.end(),
+		[](const Entry& e1, const Entry& e2) {
+			if (e1.weight != e2.weight)
+				return e1.weight > e2.weight;
+			if (e1.cfg->addr() != e2.cfg->addr())
+				return e1.cfg->addr() < e2.cfg->addr();
+			if (e1.depth != e2.depth)
+				return e1.depth < e2.depth;
+			return e1.headerAddr < e2.headerAddr;
+		});
+	m_entries.erase(middle, m_entries.end());
+}
+
+std::string CFGLoops::str() const {
+	std::stringstream ss;
+
+	for (const Entry& entry : m_entries) {
+		ss << std::hex << "[loop 0x" << entry.cfg->addr() << " \""
+		   << entry.cfg->functionName() << "\" " << entry.header << std::dec
+		   << " depth:" << entry.depth
+		   << " blocks:" << entry.size
+		   << " entries:" << entry.entries
+		   << " back:" << entry.backEdges
+		   << " trips:" << std::fixed << std::setprecision(2) << entry.tripCount
+		   << " weight:" << entry.weight
+		   << " " << (entry.reducible ? "reducible" : "irreducible") << "]" << std::endl;
+	}
+
+	return ss.str();
+}
+
+std::string CFGLoops::toJSON() const {
+	json report = json::array();
+
+	for (const Entry& entry : m_entries) {
+		std::stringstream ss;
+		ss << std::hex << "0x" << entry.cfg->addr();
+
+		report.push_back({
+			{ "function", ss.str() },
+			{ "name", entry.cfg->functionName() },
+			{ "header", entry.header },
+			{ "depth", entry.depth },
+			{ "blocks", entry.size },
+			{ "entries", entry.entries },
+			{ "backEdges", entry.backEdges },
+			{ "tripCount", entry.tripCount },
+			{ "weight", entry.weight },
+			{ "reducible", entry.reducible }
+		});
+	}
+
+	return report.dump(2);
+}
@@ -21,19 +21,29 @@
 */
 
 #include <cassert>
+#include <fstream>
+#include <iostream>
+#include <iterator>
 #include <algorithm>
 
 #include <CFG.h>
 #include <CfgEdge.h>
 #include <CfgNode.h>
 #include <CFGReader.h>
+#include <ThreadPool.h>
+#include <MemoryUsage.h>
 
 CFGReader::CFGReader(const std::string& filename)
-	: m_input(filename, std::fstream::in) {
+	: CFGReader(new std::ifstream(filename)) {
+}
+
+CFGReader::CFGReader(std::istream* input)
+	: m_stream(input), m_input(*input), m_jobs(1),
+	  m_reportMemory(false) {
 }
 
 CFGReader::~CFGReader() {
-	m_input.close();
+	delete m_stream;
 
 	for (std::map<Addr, CFG*>::iterator it = m_cfgs.begin(),
 			ed = m_cfgs.end(); it != ed; it++) {
@@ -41,11 +51,14 @@ CFGReader::~CFGReader() {
 	}
 }
 
-std::set<CFG*> CFGReader::cfgs() const {
-	std::set<CFG*> cfgs;
+std::list<CFG*> CFGReader::cfgs() const {
+	std::lock_guard<std::mutex> lock(m_cfgsMutex);
+	std::list<CFG*> cfgs;
 
+	// Keep the address order, so the output does not depend on the
+	// order the CFGs were allocated.
 	std::transform(m_cfgs.begin(), m_cfgs.end(),
-		std::inserter(cfgs, cfgs.begin()),
+		std::back_inserter(cfgs),
 		[](const std::map<Addr, CFG*>::value_type &pair) {
 			return pair.second;
 		}
@@ -55,20 +68,105 @@ std::set<CFG*> CFGReader::cfgs() const {
 }
 
 CFG* CFGReader::cfg(Addr addr) const {
+	std::lock_guard<std::mutex> lock(m_cfgsMutex);
 	std::map<Addr, CFG*>::const_iterator it = m_cfgs.find(addr);
 	return it != m_cfgs.end() ? it->second : 0;
 }
 
 CFG* CFGReader::instance(Addr addr) {
-	CFG* cfg = this->cfg(addr);
-	if (cfg == 0) {
+	std::lock_guard<std::mutex> lock(m_cfgsMutex);
+	CFG*& cfg = m_cfgs[addr];
+	if (cfg == 0)
 		cfg = new CFG(addr);
-		m_cfgs[addr] = cfg;
-	}
 
 	return cfg;
 }
 
+void CFGReader::merge(const CFGReader& other) {
+	for (CFG* src : other.cfgs()) {
+		CFG* dst = this->instance(src->addr());
+		if (dst->functionName() == "unknown")
+			dst->setFunctionName(src->functionName());
+
+		dst->updateExecs(src->execs());
+		if (src->repaired())
+			dst->setRepaired();
+
+		// Create the missing nodes and merge the blocks data.
+		std::map<CfgNode*, CfgNode*> nodes;
+		for (CfgNode* node : src->nodes()) {
+			switch (node->type()) {
+				case CfgNode::CFG_ENTRY:
+					nodes[node] = CFGReader::entryNode(dst);
+					break;
+				case CfgNode::CFG_EXIT:
+					nodes[node] = CFGReader::exitNode(dst);
+					break;
+				case CfgNode::CFG_HALT:
+					nodes[node] = CFGReader::haltNode(dst);
+					break;
+				case CfgNode::CFG_PHANTOM:
+					nodes[node] = CFGReader::nodeWithAddr(dst, CfgNode::node2addr(node));
+					break;
+				case CfgNode::CFG_BLOCK: {
+					CfgNode::BlockData* data =
+						static_cast<CfgNode::BlockData*>(node->data());
+					assert(data != 0);
+
+					CfgNode* block = CFGReader::nodeWithAddr(dst, data->addr());
+					if (block->type() == CfgNode::CFG_PHANTOM)
+						dst->promotePhantom(block, data->size());
+					nodes[node] = block;
+
+					if (data->indirect())
+						CFGReader::markIndirect(block);
+
+					for (CfgCall* call : data->calls()) {
+						CFGReader::addCall(block, this->instance(call->called()->addr()),
+							call->count());
+					}
+
+					for (CfgSignalHandler* sigHandler : data->signalHandlers()) {
+						CFGReader::addSignalHandler(block, sigHandler->sigid(),
+							this->instance(sigHandler->handler()->addr()),
+							sigHandler->count());
+					}
+					} break;
+				default:
+					assert(false);
+			}
+		}
+
+		for (CfgEdge* edge : src->edges())
+			dst->addEdge(nodes[edge->source()], nodes[edge->destination()], edge->count());
+
+		// The calls and flags were merged into the blocks in place.
+		dst->invalidate();
+	}
+}
+
+void CFGReader::checkCFGs() {
+	ThreadPool pool(m_jobs);
+	for (CFG* cfg : this->cfgs())
+		pool.submit([cfg] { cfg->check(); });
+	pool.wait();
+}
+
+void CFGReader::startPhases() const {
+	if (m_reportMemory)
+		MemoryUsage::resetPeak();
+}
+
+void CFGReader::endPhase(const std::string& phase) const {
+	if (!m_reportMemory)
+		return;
+
+	std::cerr << "memory: " << phase << ": peak " << MemoryUsage::peakRSS()
+		<< " KB, rss " << MemoryUsage::currentRSS() << " KB" << std::endl;
+
+	MemoryUsage::resetPeak();
+}
+
 CfgNode* CFGReader::entryNode(CFG* cfg) {
 	CfgNode* entry_node = cfg->entryNode();
 	if (entry_node == 0) {
@@ -104,7 +202,7 @@ CfgNode* CFGReader::exitNode(CFG* cfg) {
 }
 
 CfgNode* CFGReader::haltNode(CFG* cfg) {
-	CfgNode* halt_node = cfg->exitNode();
+	CfgNode* halt_node = cfg->haltNode();
 	if (halt_node == 0) {
 		halt_node = new CfgNode(CfgNode::CFG_HALT);
 		cfg->addNode(halt_node);
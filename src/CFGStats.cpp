@@ -0,0 +1,229 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#include <cassert>
+#include <sstream>
+#include <vector>
+#include <unordered_set>
+
+#include <CFG.h>
+#include <CfgNode.h>
+#include <CFGStats.h>
+#include <CFGGrindStream.h>
+
+CFGStats::CFGStats() : m_functions(0), m_valid(0), m_blocks(0), m_phantoms(0),
+		m_edges(0), m_indirect(0), m_execs(0) {
+}
+
+CFGStats::~CFGStats() {
+}
+
+void CFGStats::loadCFGGrind(const std::string& filename) {
+	std::map<Addr, FunctionFlow> functions;
+
+	CFGGrindStream stream(filename);
+	CFGGrindStream::Record record;
+	while (stream.nextRecord(record)) {
+		FunctionFlow& function = functions[record.faddr];
+		if (record.type == CFGGrindStream::Record::CFG_RECORD) {
+			function.execs += record.execs;
+			continue;
+		}
+
+		assert(record.type == CFGGrindStream::Record::NODE_RECORD);
+		const CFGGrindStream::Node& node = record.node;
+
+		BlockFlow& block = function.blocks[node.addr];
+		block.defined = true;
+
+		// As the reader does, the entry edge takes the executions
+		// known so far.
+		if (node.addr == record.faddr) {
+			function.hasEntry = true;
+			function.entryCount = function.execs;
+			function.edges++;
+
+			block.reached = true;
+			block.inflow += function.execs;
+		}
+
+		if (node.indirect)
+			function.indirect++;
+
+		for (const std::pair<const Addr, unsigned long long>& succ : node.succs) {
+			BlockFlow& dst = function.blocks[succ.first];
+			dst.reached = true;
+			dst.inflow += succ.second;
+
+			block.outflow += succ.second;
+			block.leaves = true;
+			function.edges++;
+		}
+
+		if (node.exit || node.halt) {
+			block.outflow += node.exitCount + node.haltCount;
+			block.leaves = true;
+
+			function.hasExit = true;
+			function.exitCount += node.exitCount + node.haltCount;
+			function.edges += (node.exit ? 1 : 0) + (node.halt ? 1 : 0);
+		}
+
+		// Called functions and handlers are instantiated as well.
+		for (const std::pair<const Addr, unsigned long long>& call : node.calls)
+			functions[call.first];
+
+		for (const std::pair<const int, std::pair<Addr, unsigned long long>>& handler :
+				node.signalHandlers)
+			functions[handler.second.first];
+	}
+
+	for (const std::pair<const Addr, FunctionFlow>& function : functions)
+		this->addFunction(function.second);
+}
+
+void CFGStats::loadBFTrace(const std::string& filename) {
+	BFTraceReader reader(filename);
+	reader.readSymbols([this](BFTraceReader::Symbol* sym) {
+		this->addSymbol(*sym);
+		delete sym;
+	});
+}
+
+void CFGStats::addSymbol(const BFTraceReader::Symbol& sym) {
+	// Each entry is a CFG with the blocks reachable from it.
+	for (Addr entry : sym.entries) {
+		FunctionFlow function;
+		function.hasEntry = true;
+		function.edges++;
+		function.blocks[entry].reached = true;
+
+		std::vector<Addr> nodes;
+		std::unordered_set<Addr> queued;
+
+		nodes.push_back(entry);
+		queued.insert(entry);
+		for (std::vector<Addr>::size_type i = 0; i < nodes.size(); i++) {
+			Addr addr = nodes[i];
+			BlockFlow& block = function.blocks[addr];
+
+			std::map<Addr, BFTraceReader::BasicBlock>::const_iterator it =
+				sym.blocks.find(addr);
+			if (it == sym.blocks.end())
+				continue;
+
+			block.defined = true;
+			if (it->second.is_exit || it->second.type == BFTraceReader::RETURN) {
+				block.leaves = true;
+				function.hasExit = true;
+				function.edges++;
+			}
+
+			std::map<Addr, std::set<Addr>>::const_iterator it2 = sym.edges.find(addr);
+			if (it2 == sym.edges.end())
+				continue;
+
+			for (Addr dst : it2->second) {
+				function.blocks[dst].reached = true;
+				function.blocks[addr].leaves = true;
+				function.edges++;
+
+				if (queued.insert(dst).second)
+					nodes.push_back(dst);
+			}
+		}
+
+		this->addFunction(function);
+	}
+}
+
+// The flow rules of CFG::check on the accumulated flows.
+void CFGStats::addFunction(const FunctionFlow& function) {
+	bool valid = function.hasEntry && function.hasExit &&
+		CFG::validFlow(function.entryCount, function.exitCount, function.execs);
+
+	for (const std::pair<const Addr, BlockFlow>& entry : function.blocks) {
+		const BlockFlow& block = entry.second;
+		if (block.defined)
+			m_blocks++;
+		else
+			m_phantoms++;
+
+		if (!CFG::validBlock(block.defined, block.reached, block.leaves,
+				block.inflow, block.outflow))
+			valid = false;
+	}
+
+	m_functions++;
+	if (valid)
+		m_valid++;
+
+	m_edges += function.edges;
+	m_indirect += function.indirect;
+	m_execs += function.execs;
+}
+
+void CFGStats::add(const CFG* cfg) {
+	m_functions++;
+	if (cfg->status() == CFG::VALID)
+		m_valid++;
+
+	for (CfgNode* node : cfg->nodes()) {
+		switch (node->type()) {
+			case CfgNode::CFG_BLOCK:
+				m_blocks++;
+				if (static_cast<CfgNode::BlockData*>(node->data())->indirect())
+					m_indirect++;
+
+				break;
+			case CfgNode::CFG_PHANTOM:
+				m_phantoms++;
+				break;
+			default:
+				break;
+		}
+	}
+
+	m_edges += cfg->edges().size();
+	m_execs += cfg->execs();
+}
+
+std::string CFGStats::str() const {
+	std::stringstream ss;
+
+	ss << "functions: " << m_functions << std::endl;
+	ss << "valid: " << m_valid << std::endl;
+	ss << "invalid: " << this->invalid() << std::endl;
+	ss << "blocks: " << m_blocks << std::endl;
+	ss << "phantoms: " << m_phantoms << std::endl;
+	ss << "edges: " << m_edges << std::endl;
+	ss << "indirect: " << m_indirect << std::endl;
+	ss << "execs: " << m_execs << std::endl;
+
+	return ss.str();
+}
+
+std::ostream& operator<<(std::ostream& os, const CFGStats& stats) {
+	os << stats.str();
+	return os;
+}
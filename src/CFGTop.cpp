@@ -0,0 +1,180 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#include <cassert>
+#include <sstream>
+#include <algorithm>
+#include <nlohmann/json.hpp>
+
+#include <CFG.h>
+#include <CfgNode.h>
+#include <CFGTop.h>
+
+using json = nlohmann::json;
+
+// With the hotter entries first, the top of the heap is the coldest one.
+bool CFGTop::Hotter::operator()(const Entry& e1, const Entry& e2) const {
+	if (e1.count != e2.count)
+		return e1.count > e2.count;
+	if (e1.cfg->addr() != e2.cfg->addr())
+		return e1.cfg->addr() < e2.cfg->addr();
+	if (e1.addr != e2.addr)
+		return e1.addr < e2.addr;
+	return (e1.called ? e1.called->addr() : 0) < (e2.called ? e2.called->addr() : 0);
+}
+
+CFGTop::CFGTop(unsigned k) : m_k(k) {
+	assert(k > 0);
+}
+
+CFGTop::~CFGTop() {
+}
+
+void CFGTop::push(Heap& heap, const Entry& entry) {
+	if (heap.size() < m_k) {
+		heap.push(entry);
+	} else if (Hotter()(entry, heap.top())) {
+		heap.pop();
+		heap.push(entry);
+	}
+}
+
+void CFGTop::add(CFG* cfg) {
+	Entry function = { cfg, cfg->addr(), 0, cfg->execs() };
+	this->push(m_functions, function);
+
+	for (CfgNode* node : cfg->nodes()) {
+		if (node->type() != CfgNode::CFG_BLOCK)
+			continue;
+
+		CfgNode::BlockData* data = static_cast<CfgNode::BlockData*>(node->data());
+		assert(data != 0);
+
+		Entry block = { cfg, data->addr(), 0, cfg->blockCount(node) };
+		this->push(m_blocks, block);
+
+		for (CfgCall* call : data->calls()) {
+			Entry site = { cfg, data->addr(), call->called(), call->count() };
+			this->push(m_calls, site);
+		}
+	}
+}
+
+std::vector<CFGTop::Entry> CFGTop::sorted(Heap heap) {
+	std::vector<Entry> entries;
+	entries.reserve(heap.size());
+	for (; !heap.empty(); heap.pop())
+		entries.push_back(heap.top());
+
+	std::reverse(entries.begin(), entries.end());
+	return entries;
+}
+
+std::vector<CFGTop::Entry> CFGTop::functions() const {
+	return CFGTop::sorted(m_functions);
+}
+
+std::vector<CFGTop::Entry> CFGTop::blocks() const {
+	return CFGTop::sorted(m_blocks);
+}
+
+std::vector<CFGTop::Entry> CFGTop::calls() const {
+	return CFGTop::sorted(m_calls);
+}
+
+std::string CFGTop::str() const {
+	std::stringstream ss;
+	unsigned rank;
+
+	ss << "[functions]" << std::endl;
+	rank = 1;
+	for (const Entry& entry : this->functions()) {
+		ss << std::dec << rank++ << ". " << std::hex << "0x" << entry.cfg->addr()
+		   << " \"" << entry.cfg->functionName() << "\": "
+		   << std::dec << entry.count << std::endl;
+	}
+
+	ss << "[blocks]" << std::endl;
+	rank = 1;
+	for (const Entry& entry : this->blocks()) {
+		ss << std::dec << rank++ << ". " << std::hex << "0x" << entry.cfg->addr()
+		   << " \"" << entry.cfg->functionName() << "\" 0x" << entry.addr << ": "
+		   << std::dec << entry.count << std::endl;
+	}
+
+	ss << "[calls]" << std::endl;
+	rank = 1;
+	for (const Entry& entry : this->calls()) {
+		ss << std::dec << rank++ << ". " << std::hex << "0x" << entry.cfg->addr()
+		   << " \"" << entry.cfg->functionName() << "\" 0x" << entry.addr
+		   << "->0x" << entry.called->addr()
+		   << " \"" << entry.called->functionName() << "\": "
+		   << std::dec << entry.count << std::endl;
+	}
+
+	return ss.str();
+}
+
+static
+std::string addr2str(Addr addr) {
+	std::stringstream ss;
+	ss << std::hex << "0x" << addr;
+	return ss.str();
+}
+
+std::string CFGTop::toJSON() const {
+	json report;
+
+	report["functions"] = json::array();
+	for (const Entry& entry : this->functions()) {
+		report["functions"].push_back({
+			{ "addr", addr2str(entry.cfg->addr()) },
+			{ "name", entry.cfg->functionName() },
+			{ "execs", entry.count }
+		});
+	}
+
+	report["blocks"] = json::array();
+	for (const Entry& entry : this->blocks()) {
+		report["blocks"].push_back({
+			{ "function", addr2str(entry.cfg->addr()) },
+			{ "name", entry.cfg->functionName() },
+			{ "addr", addr2str(entry.addr) },
+			{ "count", entry.count }
+		});
+	}
+
+	report["calls"] = json::array();
+	for (const Entry& entry : this->calls()) {
+		report["calls"].push_back({
+			{ "function", addr2str(entry.cfg->addr()) },
+			{ "name", entry.cfg->functionName() },
+			{ "block", addr2str(entry.addr) },
+			{ "called", addr2str(entry.called->addr()) },
+			{ "calledName", entry.called->functionName() },
+			{ "count", entry.count }
+		});
+	}
+
+	return report.dump(2);
+}
@@ -0,0 +1,416 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#include <cassert>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+#include <CFG.h>
+#include <CfgNode.h>
+#include <CallGraph.h>
+#include <ThreadPool.h>
+
+CallGraph::CallGraph(const std::list<CFG*>& cfgs, unsigned jobs) {
+	this->build(cfgs, jobs);
+	this->condense();
+	this->propagate();
+}
+
+CallGraph::~CallGraph() {
+}
+
+unsigned CallGraph::functionIndex(CFG* cfg) {
+	std::unordered_map<CFG*, unsigned>::const_iterator it = m_index.find(cfg);
+	if (it != m_index.end())
+		return it->second;
+
+	Function function;
+	function.cfg = cfg;
+	function.blocks = function.instrs = 0;
+	function.inclusiveBlocks = function.inclusiveInstrs = 0;
+	function.scc = 0;
+	m_functions.push_back(function);
+
+	unsigned idx = m_functions.size() - 1;
+	m_index[cfg] = idx;
+	return idx;
+}
+
+struct CallSite {
+	Addr site;
+	CFG* callee;
+	unsigned long long count;
+	bool signal;
+};
+
+void CallGraph::build(const std::list<CFG*>& cfgs, unsigned jobs) {
+	std::vector<CFG*> all(cfgs.cbegin(), cfgs.cend());
+	std::vector<std::vector<BlockCost>> costs(all.size());
+	std::vector<std::vector<CallSite>> sites(all.size());
+
+	// The costs and call sites of each CFG are independent.
+	ThreadPool pool(jobs);
+	for (std::vector<CFG*>::size_type i = 0; i < all.size(); i++) {
+		CFG* cfg = all[i];
+		std::vector<BlockCost>& cost = costs[i];
+		std::vector<CallSite>& site = sites[i];
+		pool.submit([cfg, &cost, &site] {
+			std::vector<CfgNode*> nodes(cfg->nodes().cbegin(), cfg->nodes().cend());
+			std::sort(nodes.begin(), nodes.end(), CfgNode::nodeOrder);
+
+			for (CfgNode* node : nodes) {
+				if (node->type() != CfgNode::CFG_BLOCK)
+					continue;
+
+				CfgNode::BlockData* data = static_cast<CfgNode::BlockData*>(node->data());
+				assert(data != 0);
+
+				unsigned long long count = cfg->blockCount(node);
+
+				BlockCost block = { data->addr(), count,
+					count * data->instructions().size() };
+				cost.push_back(block);
+
+				std::vector<CallSite> calls;
+				for (CfgCall* call : data->calls()) {
+					CallSite c = { data->addr(), call->called(), call->count(), false };
+					calls.push_back(c);
+				}
+
+				for (CfgSignalHandler* handler : data->signalHandlers()) {
+					CallSite c = { data->addr(), handler->handler(), handler->count(), true };
+					calls.push_back(c);
+				}
+
+				std::sort(calls.begin(), calls.end(), [](const CallSite& c1, const CallSite& c2) {
+					if (c1.callee->addr() != c2.callee->addr())
+						return c1.callee->addr() < c2.callee->addr();
+					return c1.signal < c2.signal;
+				});
+				site.insert(site.end(), calls.cbegin(), calls.cend());
+			}
+		});
+	}
+	pool.wait();
+
+	for (CFG* cfg : all)
+		this->functionIndex(cfg);
+
+	for (std::vector<CFG*>::size_type i = 0; i < all.size(); i++) {
+		Function& function = m_functions[m_index[all[i]]];
+		function.costs.swap(costs[i]);
+		for (const BlockCost& cost : function.costs) {
+			function.blocks += cost.blocks;
+			function.instrs += cost.instrs;
+		}
+
+		unsigned caller = m_index[all[i]];
+		for (const CallSite& site : sites[i]) {
+			Call call = { caller, this->functionIndex(site.callee), site.site,
+				site.count, site.signal };
+			m_calls.push_back(call);
+		}
+	}
+}
+
+// Iterative Tarjan's algorithm; components are found callees first.
+void CallGraph::condense() {
+	unsigned size = m_functions.size();
+	std::vector<std::vector<unsigned>> succs(size);
+	m_selfCalls.assign(size, false);
+	for (const Call& call : m_calls) {
+		if (call.caller == call.callee)
+			m_selfCalls[call.caller] = true;
+		else
+			succs[call.caller].push_back(call.callee);
+	}
+
+	for (std::vector<unsigned>& s : succs) {
+		std::sort(s.begin(), s.end());
+		s.erase(std::unique(s.begin(), s.end()), s.end());
+	}
+
+	const int undefined = -1;
+	std::vector<int> index(size, undefined), lowlink(size, 0);
+	std::vector<bool> onStack(size, false);
+	std::vector<unsigned> stack;
+	std::vector<std::pair<unsigned, std::vector<unsigned>::size_type>> calls;
+	int counter = 0;
+
+	for (unsigned root = 0; root < size; root++) {
+		if (index[root] != undefined)
+			continue;
+
+		calls.push_back(std::make_pair(root, 0));
+		while (!calls.empty()) {
+			unsigned v = calls.back().first;
+			std::vector<unsigned>::size_type& next = calls.back().second;
+
+			if (next == 0 && index[v] == undefined) {
+				index[v] = lowlink[v] = counter++;
+				stack.push_back(v);
+				onStack[v] = true;
+			}
+
+			if (next < succs[v].size()) {
+				unsigned w = succs[v][next++];
+				if (index[w] == undefined)
+					calls.push_back(std::make_pair(w, 0));
+				else if (onStack[w])
+					lowlink[v] = std::min(lowlink[v], index[w]);
+
+				continue;
+			}
+
+			if (lowlink[v] == index[v]) {
+				std::vector<unsigned> scc;
+				unsigned w;
+				do {
+					w = stack.back();
+					stack.pop_back();
+					onStack[w] = false;
+					m_functions[w].scc = m_sccs.size();
+					scc.push_back(w);
+				} while (w != v);
+
+				std::sort(scc.begin(), scc.end());
+				m_sccs.push_back(scc);
+			}
+
+			calls.pop_back();
+			if (!calls.empty()) {
+				unsigned u = calls.back().first;
+				lowlink[u] = std::min(lowlink[u], lowlink[v]);
+			}
+		}
+	}
+}
+
+bool CallGraph::recursive(unsigned scc) const {
+	assert(scc < m_sccs.size());
+	return m_sccs[scc].size() > 1 || m_selfCalls[m_sccs[scc][0]];
+}
+
+double CallGraph::share(const Call& call) const {
+	unsigned scc = m_functions[call.callee].scc;
+	return (m_sccCalls[scc] > 0 ? (double) call.count / m_sccCalls[scc] : 0.0);
+}
+
+void CallGraph::propagate() {
+	m_sccCalls.assign(m_sccs.size(), 0);
+	std::vector<std::vector<const Call*>> outgoing(m_sccs.size());
+	for (const Call& call : m_calls) {
+		unsigned from = m_functions[call.caller].scc;
+		unsigned to = m_functions[call.callee].scc;
+		if (from == to)
+			continue;
+
+		m_sccCalls[to] += call.count;
+		outgoing[from].push_back(&call);
+	}
+
+	// Callees are visited first, so their inclusive counts are final.
+	for (std::vector<std::vector<unsigned>>::size_type scc = 0; scc < m_sccs.size(); scc++) {
+		double blocks = 0, instrs = 0;
+		for (unsigned f : m_sccs[scc]) {
+			blocks += m_functions[f].blocks;
+			instrs += m_functions[f].instrs;
+		}
+
+		for (const Call* call : outgoing[scc]) {
+			const Function& callee = m_functions[call->callee];
+			assert(callee.scc < scc);
+
+			double share = this->share(*call);
+			blocks += share * callee.inclusiveBlocks;
+			instrs += share * callee.inclusiveInstrs;
+		}
+
+		for (unsigned f : m_sccs[scc]) {
+			m_functions[f].inclusiveBlocks = blocks;
+			m_functions[f].inclusiveInstrs = instrs;
+		}
+	}
+}
+
+static
+std::string functionName(const CFG* cfg) {
+	if (cfg->functionName() != "unknown")
+		return cfg->functionName();
+
+	std::stringstream ss;
+	ss << std::hex << "0x" << cfg->addr();
+	return ss.str();
+}
+
+std::string CallGraph::str() const {
+	std::stringstream ss;
+
+	for (const Function& function : m_functions) {
+		ss << std::hex << "[function 0x" << function.cfg->addr() << " \""
+		   << function.cfg->functionName() << "\"" << std::dec
+		   << " blocks:" << function.blocks
+		   << " instrs:" << function.instrs
+		   << " inclusive-blocks:" << std::fixed << std::setprecision(0)
+		   << function.inclusiveBlocks
+		   << " inclusive-instrs:" << function.inclusiveInstrs
+		   << " scc:" << function.scc;
+		if (this->recursive(function.scc))
+			ss << " recursive";
+		ss << "]" << std::endl;
+	}
+
+	for (const Call& call : m_calls) {
+		ss << std::hex << (call.signal ? "[signal 0x" : "[call 0x")
+		   << m_functions[call.caller].cfg->addr() << " 0x" << call.site
+		   << "->0x" << m_functions[call.callee].cfg->addr();
+		if (call.count > 0)
+			ss << std::dec << ":" << call.count;
+		ss << "]" << std::endl;
+	}
+
+	return ss.str();
+}
+
+static
+std::string dotEscape(const std::string& str) {
+	std::string escaped;
+	for (char c : str) {
+		if (c == '"' || c == '<' || c == '>' || c == '{' || c == '}' || c == '|' || c == '\\')
+			escaped += '\\';
+		escaped += c;
+	}
+
+	return escaped;
+}
+
+std::string CallGraph::toDOT() const {
+	std::stringstream ss;
+
+	ss << "digraph \"callgraph\" {" << std::endl;
+	ss << "  node[shape=record]" << std::endl;
+	ss << std::endl;
+
+	for (std::vector<std::vector<unsigned>>::size_type scc = 0; scc < m_sccs.size(); scc++) {
+		bool cluster = m_sccs[scc].size() > 1;
+		if (cluster) {
+			ss << "  subgraph \"cluster_scc" << std::dec << scc << "\" {" << std::endl;
+			ss << "    label = \"scc " << scc << "\"" << std::endl;
+		}
+
+		for (unsigned f : m_sccs[scc]) {
+			const Function& function = m_functions[f];
+			ss << (cluster ? "    " : "  ") << std::hex << "\"0x" << function.cfg->addr()
+			   << "\" [label=\"{" << dotEscape(function.cfg->functionName())
+			   << "|0x" << function.cfg->addr() << std::dec
+			   << "|self: " << function.instrs << " instrs, " << function.blocks << " blocks\\l"
+			   << "inclusive: " << std::fixed << std::setprecision(0)
+			   << function.inclusiveInstrs << " instrs, "
+			   << function.inclusiveBlocks << " blocks\\l}\"]" << std::endl;
+		}
+
+		if (cluster)
+			ss << "  }" << std::endl;
+	}
+
+	ss << std::endl;
+
+	// One edge per caller and callee, adding up the call sites.
+	std::map<std::pair<std::pair<unsigned, unsigned>, bool>, unsigned long long> edges;
+	for (const Call& call : m_calls)
+		edges[std::make_pair(std::make_pair(call.caller, call.callee), call.signal)] += call.count;
+
+	for (std::map<std::pair<std::pair<unsigned, unsigned>, bool>, unsigned long long>::const_iterator
+			it = edges.cbegin(), ed = edges.cend(); it != ed; ++it) {
+		ss << std::hex << "  \"0x" << m_functions[it->first.first.first].cfg->addr()
+		   << "\" -> \"0x" << m_functions[it->first.first.second].cfg->addr() << "\""
+		   << std::dec << " [label=\" " << it->second << "\"";
+		if (it->first.second)
+			ss << ",style=dashed";
+		ss << "]" << std::endl;
+	}
+
+	ss << "}" << std::endl;
+
+	return ss.str();
+}
+
+std::string CallGraph::toCallgrind() const {
+	std::stringstream ss;
+	std::vector<bool> named(m_functions.size(), false);
+
+	auto fnRef = [this, &named](unsigned f) {
+		std::stringstream ref;
+		ref << "(" << std::dec << (f + 1) << ")";
+		if (!named[f]) {
+			ref << " " << functionName(m_functions[f].cfg);
+			named[f] = true;
+		}
+
+		return ref.str();
+	};
+
+	unsigned long long instrs = 0, blocks = 0;
+	for (const Function& function : m_functions) {
+		instrs += function.instrs;
+		blocks += function.blocks;
+	}
+
+	ss << "# callgrind format" << std::endl;
+	ss << "version: 1" << std::endl;
+	ss << "creator: cfgconv" << std::endl;
+	ss << "positions: instr" << std::endl;
+	ss << "events: Ir Bb" << std::endl;
+	ss << "summary: " << instrs << " " << blocks << std::endl;
+
+	// Calls of each function, already in caller and block order.
+	std::vector<std::vector<const Call*>> calls(m_functions.size());
+	for (const Call& call : m_calls)
+		calls[call.caller].push_back(&call);
+
+	for (unsigned f = 0; f < m_functions.size(); f++) {
+		const Function& function = m_functions[f];
+
+		ss << std::endl;
+		ss << "fn=" << fnRef(f) << std::endl;
+		for (const BlockCost& cost : function.costs) {
+			ss << std::hex << "0x" << cost.addr << std::dec << " "
+			   << cost.instrs << " " << cost.blocks << std::endl;
+		}
+
+		for (const Call* call : calls[f]) {
+			const Function& callee = m_functions[call->callee];
+			double share = (function.scc == callee.scc ? 0.0 : this->share(*call));
+
+			ss << "cfn=" << fnRef(call->callee) << std::endl;
+			ss << "calls=" << std::dec << call->count << std::hex
+			   << " 0x" << callee.cfg->addr() << std::endl;
+			ss << std::hex << "0x" << call->site << std::dec << std::fixed
+			   << std::setprecision(0) << " " << share * callee.inclusiveInstrs
+			   << " " << share * callee.inclusiveBlocks << std::endl;
+		}
+	}
+
+	return ss.str();
+}
@@ -21,6 +21,7 @@
 */
 
 #include <cassert>
+#include <sstream>
 #include <algorithm>
 
 #include <CFG.h>
@@ -206,3 +207,35 @@ Addr CfgNode::node2addr(CfgNode* node) {
 			return 0;
 	}
 }
+
+std::string CfgNode::node2name(CfgNode* node) {
+	assert(node != 0);
+	switch (node->type()) {
+		case CfgNode::CFG_ENTRY:
+			return "entry";
+		case CfgNode::CFG_PHANTOM:
+		case CfgNode::CFG_BLOCK: {
+			std::stringstream ss;
+			ss << std::hex << "0x" << node2addr(node);
+			return ss.str();
+			} break;
+		case CfgNode::CFG_EXIT:
+			return "exit";
+		case CfgNode::CFG_HALT:
+			return "halt";
+		default:
+			assert(false);
+	}
+	return "";
+}
+
+bool CfgNode::nodeOrder(CfgNode* n1, CfgNode* n2) {
+	Addr a1 = node2addr(n1);
+	Addr a2 = node2addr(n2);
+	if (a1 != 0 && a2 != 0)
+		return a1 < a2;
+	else if (a1 != 0 || a2 != 0)
+		return a1 != 0;
+	else
+		return n1->type() < n2->type();
+}
@@ -0,0 +1,460 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#include <map>
+#include <set>
+#include <cassert>
+#include <sstream>
+#include <algorithm>
+
+#include <CFG.h>
+#include <CfgEdge.h>
+#include <CfgNode.h>
+#include <CFGReader.h>
+#include <InputTokenizer.h>
+#include <ChainCompaction.h>
+
+ChainCompaction::ChainCompaction(CFG* cfg) : m_cfg(cfg), m_blocks(0) {
+	this->compact();
+}
+
+ChainCompaction::ChainCompaction(CFG* cfg, const std::vector<Chain>& chains)
+	: m_cfg(cfg), m_blocks(0), m_chains(chains) {
+	for (CfgNode* node : m_cfg->nodes()) {
+		if (node->type() == CfgNode::CFG_BLOCK)
+			m_blocks++;
+	}
+
+	for (const Chain& chain : m_chains) {
+		assert(!chain.members.empty());
+		assert(chain.counts.size() + 1 == chain.members.size());
+
+		int size = 0;
+		for (const Member& member : chain.members)
+			size += member.size;
+
+		CfgNode* superblock = m_cfg->nodeByAddr(chain.members.front().addr);
+		if (superblock == 0 || superblock->type() != CfgNode::CFG_BLOCK ||
+				static_cast<CfgNode::BlockData*>(superblock->data())->size() != size) {
+			std::stringstream ss;
+			ss << std::hex << "Chain 0x" << chain.members.front().addr
+			   << " does not match a superblock of function 0x" << m_cfg->addr();
+			throw ss.str();
+		}
+
+		m_blocks += chain.members.size() - 1;
+	}
+}
+
+ChainCompaction::~ChainCompaction() {
+}
+
+unsigned ChainCompaction::compacted() const {
+	unsigned blocks = m_blocks;
+	for (const Chain& chain : m_chains)
+		blocks -= chain.members.size() - 1;
+
+	return blocks;
+}
+
+// Block that node falls through to and can absorb, if any.
+static
+CfgNode* follower(CFG* cfg, CfgNode* node) {
+	if (node->type() != CfgNode::CFG_BLOCK)
+		return 0;
+
+	const std::set<CfgNode*>& succs = cfg->successors(node);
+	if (succs.size() != 1)
+		return 0;
+
+	CfgNode* succ = *succs.begin();
+	if (succ == node || succ->type() != CfgNode::CFG_BLOCK ||
+			cfg->predecessors(succ).size() != 1)
+		return 0;
+
+	CfgNode::BlockData* data = static_cast<CfgNode::BlockData*>(node->data());
+	CfgNode::BlockData* next = static_cast<CfgNode::BlockData*>(succ->data());
+	assert(data != 0 && next != 0);
+
+	if (data->indirect() || data->size() <= 0 ||
+			next->addr() != data->addr() + data->size())
+		return 0;
+
+	return succ;
+}
+
+static
+CfgNode* createBlock(Addr addr, int size, bool indirect,
+		const std::vector<ChainCompaction::Call>& calls,
+		const std::vector<ChainCompaction::SignalHandler>& signalHandlers) {
+	CfgNode::BlockData* data = new CfgNode::BlockData(addr, size, indirect);
+	for (const ChainCompaction::Call& call : calls)
+		data->addCall(call.called, call.count);
+	for (const ChainCompaction::SignalHandler& handler : signalHandlers)
+		data->addSignalHandler(handler.sigid, handler.handler, handler.count);
+
+	CfgNode* node = new CfgNode(CfgNode::CFG_BLOCK);
+	node->setData(data);
+
+	return node;
+}
+
+void ChainCompaction::compact() {
+	std::vector<CfgNode*> nodes;
+	for (CfgNode* node : m_cfg->nodes()) {
+		if (node->type() == CfgNode::CFG_BLOCK)
+			nodes.push_back(node);
+	}
+	std::sort(nodes.begin(), nodes.end(), CfgNode::nodeOrder);
+	m_blocks = nodes.size();
+
+	std::set<CfgNode*> absorbed;
+	for (CfgNode* node : nodes) {
+		CfgNode* next = follower(m_cfg, node);
+		if (next)
+			absorbed.insert(next);
+	}
+
+	for (CfgNode* head : nodes) {
+		if (absorbed.count(head))
+			continue;
+
+		// A superblock holds a single handler per signal.
+		std::vector<CfgNode*> members;
+		std::map<int, CFG*> handlers;
+		for (CfgNode* node = head; node != 0; node = follower(m_cfg, node)) {
+			CfgNode::BlockData* data = static_cast<CfgNode::BlockData*>(node->data());
+
+			bool conflict = false;
+			for (CfgSignalHandler* handler : data->signalHandlers()) {
+				std::map<int, CFG*>::const_iterator it = handlers.find(handler->sigid());
+				if (it != handlers.end() && it->second != handler->handler())
+					conflict = true;
+			}
+			if (conflict)
+				break;
+
+			for (CfgSignalHandler* handler : data->signalHandlers())
+				handlers[handler->sigid()] = handler->handler();
+
+			members.push_back(node);
+		}
+
+		if (members.size() < 2)
+			continue;
+
+		Chain chain;
+		int size = 0;
+		std::vector<Call> calls;
+		std::vector<SignalHandler> signalHandlers;
+		for (std::vector<CfgNode*>::size_type i = 0; i < members.size(); i++) {
+			CfgNode::BlockData* data = static_cast<CfgNode::BlockData*>(members[i]->data());
+
+			Member member;
+			member.addr = data->addr();
+			member.size = data->size();
+			member.indirect = data->indirect();
+			for (CfgCall* call : data->calls()) {
+				Call c = { call->called(), call->count() };
+				member.calls.push_back(c);
+			}
+			for (CfgSignalHandler* handler : data->signalHandlers()) {
+				SignalHandler h = { handler->sigid(), handler->handler(), handler->count() };
+				member.signalHandlers.push_back(h);
+			}
+
+			calls.insert(calls.end(), member.calls.cbegin(), member.calls.cend());
+			signalHandlers.insert(signalHandlers.end(),
+				member.signalHandlers.cbegin(), member.signalHandlers.cend());
+			size += member.size;
+			chain.members.push_back(member);
+
+			if (i + 1 < members.size())
+				chain.counts.push_back(m_cfg->findEdge(members[i], members[i + 1])->count());
+		}
+
+		// A loop around the whole chain becomes a self loop (a null successor).
+		CfgNode* first = members.front();
+		CfgNode* last = members.back();
+		std::vector<std::pair<CfgNode*, unsigned long long>> preds, succs;
+		for (CfgNode* pred : m_cfg->predecessors(first)) {
+			if (pred != last)
+				preds.push_back(std::make_pair(pred, m_cfg->findEdge(pred, first)->count()));
+		}
+		for (CfgNode* succ : m_cfg->successors(last))
+			succs.push_back(std::make_pair(succ != first ? succ : 0,
+				m_cfg->findEdge(last, succ)->count()));
+
+		for (CfgNode* member : members)
+			m_cfg->removeNode(member);
+
+		CfgNode* superblock = createBlock(chain.members.front().addr, size,
+			chain.members.back().indirect, calls, signalHandlers);
+		m_cfg->addNode(superblock);
+
+		for (const std::pair<CfgNode*, unsigned long long>& pred : preds)
+			m_cfg->addEdge(pred.first, superblock, pred.second);
+		for (const std::pair<CfgNode*, unsigned long long>& succ : succs)
+			m_cfg->addEdge(superblock, succ.first ? succ.first : superblock, succ.second);
+
+		m_chains.push_back(chain);
+	}
+
+	m_cfg->check();
+}
+
+void ChainCompaction::expand() {
+	for (const Chain& chain : m_chains) {
+		CfgNode* superblock = m_cfg->nodeByAddr(chain.members.front().addr);
+		assert(superblock != 0 && superblock->type() == CfgNode::CFG_BLOCK);
+
+		std::vector<std::pair<CfgNode*, unsigned long long>> preds, succs;
+		for (CfgNode* pred : m_cfg->predecessors(superblock)) {
+			if (pred != superblock)
+				preds.push_back(std::make_pair(pred, m_cfg->findEdge(pred, superblock)->count()));
+		}
+		for (CfgNode* succ : m_cfg->successors(superblock))
+			succs.push_back(std::make_pair(succ != superblock ? succ : 0,
+				m_cfg->findEdge(superblock, succ)->count()));
+
+		m_cfg->removeNode(superblock);
+
+		std::vector<CfgNode*> members;
+		for (const Member& member : chain.members) {
+			CfgNode* node = createBlock(member.addr, member.size, member.indirect,
+				member.calls, member.signalHandlers);
+			m_cfg->addNode(node);
+			members.push_back(node);
+		}
+
+		for (std::vector<CfgNode*>::size_type i = 0; i + 1 < members.size(); i++)
+			m_cfg->addEdge(members[i], members[i + 1], chain.counts[i]);
+
+		for (const std::pair<CfgNode*, unsigned long long>& pred : preds)
+			m_cfg->addEdge(pred.first, members.front(), pred.second);
+		for (const std::pair<CfgNode*, unsigned long long>& succ : succs)
+			m_cfg->addEdge(members.back(), succ.first ? succ.first : members.front(), succ.second);
+	}
+
+	m_chains.clear();
+	m_cfg->check();
+}
+
+// [0xADDR SIZE [CALLS] [SIGNAL HANDLERS] INDIRECT], as in a cfggrind node.
+static
+void writeMember(std::ostream& os, const ChainCompaction::Member& member) {
+	os << std::hex << "[0x" << member.addr << std::dec << " " << member.size;
+
+	std::vector<ChainCompaction::Call> calls(member.calls);
+	std::sort(calls.begin(), calls.end(),
+		[](const ChainCompaction::Call& c1, const ChainCompaction::Call& c2) {
+			return c1.called->addr() < c2.called->addr();
+		});
+
+	os << " [";
+	for (std::vector<ChainCompaction::Call>::const_iterator it = calls.cbegin(),
+			ed = calls.cend(); it != ed; ++it) {
+		if (it != calls.cbegin())
+			os << " ";
+
+		os << std::hex << "0x" << it->called->addr();
+		if (it->count > 0)
+			os << std::dec << ":" << it->count;
+	}
+	os << "]";
+
+	std::vector<ChainCompaction::SignalHandler> handlers(member.signalHandlers);
+	std::sort(handlers.begin(), handlers.end(),
+		[](const ChainCompaction::SignalHandler& s1, const ChainCompaction::SignalHandler& s2) {
+			return s1.sigid < s2.sigid;
+		});
+
+	os << " [";
+	for (std::vector<ChainCompaction::SignalHandler>::const_iterator it = handlers.cbegin(),
+			ed = handlers.cend(); it != ed; ++it) {
+		if (it != handlers.cbegin())
+			os << " ";
+
+		os << std::dec << it->sigid << "->" << std::hex << "0x" << it->handler->addr();
+		if (it->count > 0)
+			os << std::dec << ":" << it->count;
+	}
+	os << "]";
+
+	os << " " << (member.indirect ? "true" : "false") << "]";
+}
+
+std::string ChainCompaction::str() const {
+	std::stringstream ss;
+
+	for (const Chain& chain : m_chains) {
+		ss << std::hex << "[chain 0x" << m_cfg->addr() << " [";
+		for (std::vector<Member>::const_iterator it = chain.members.cbegin(),
+				ed = chain.members.cend(); it != ed; ++it) {
+			if (it != chain.members.cbegin())
+				ss << " ";
+
+			writeMember(ss, *it);
+		}
+
+		ss << "] [";
+		for (std::vector<unsigned long long>::const_iterator it = chain.counts.cbegin(),
+				ed = chain.counts.cend(); it != ed; ++it) {
+			if (it != chain.counts.cbegin())
+				ss << " ";
+
+			ss << std::dec << *it;
+		}
+		ss << "]]" << std::endl;
+	}
+
+	return ss.str();
+}
+
+static
+void matchToken(InputTokenizer& tokens, InputTokenizer::Lexeme& current,
+		InputTokenizer::Lexeme::Type type) {
+	if (current.type != type)
+		throw std::string("Invalid chain mapping near: ") + current.token;
+
+	current = tokens.nextToken();
+}
+
+static
+CFG* function(const CFGReader& reader, Addr addr) {
+	CFG* cfg = reader.cfg(addr);
+	if (cfg == 0) {
+		std::stringstream ss;
+		ss << std::hex << "Unknown function in chain mapping: 0x" << addr;
+		throw ss.str();
+	}
+
+	return cfg;
+}
+
+// Count after a colon, if any.
+static
+unsigned long long readCount(InputTokenizer& tokens, InputTokenizer::Lexeme& current) {
+	unsigned long long count = 0;
+	if (current.type == InputTokenizer::Lexeme::TKN_COLON) {
+		matchToken(tokens, current, InputTokenizer::Lexeme::TKN_COLON);
+
+		count = current.data.number;
+		matchToken(tokens, current, InputTokenizer::Lexeme::TKN_NUMBER);
+	}
+
+	return count;
+}
+
+static
+ChainCompaction::Member readMember(InputTokenizer& tokens, InputTokenizer::Lexeme& current,
+		const CFGReader& reader) {
+	ChainCompaction::Member member;
+
+	matchToken(tokens, current, InputTokenizer::Lexeme::TKN_BRACKET_OPEN);
+
+	member.addr = current.data.addr;
+	matchToken(tokens, current, InputTokenizer::Lexeme::TKN_ADDR);
+
+	member.size = current.data.number;
+	matchToken(tokens, current, InputTokenizer::Lexeme::TKN_NUMBER);
+
+	matchToken(tokens, current, InputTokenizer::Lexeme::TKN_BRACKET_OPEN);
+	while (current.type != InputTokenizer::Lexeme::TKN_BRACKET_CLOSE) {
+		Addr addr = current.data.addr;
+		matchToken(tokens, current, InputTokenizer::Lexeme::TKN_ADDR);
+
+		ChainCompaction::Call call;
+		call.called = function(reader, addr);
+		call.count = readCount(tokens, current);
+		member.calls.push_back(call);
+	}
+	matchToken(tokens, current, InputTokenizer::Lexeme::TKN_BRACKET_CLOSE);
+
+	matchToken(tokens, current, InputTokenizer::Lexeme::TKN_BRACKET_OPEN);
+	while (current.type != InputTokenizer::Lexeme::TKN_BRACKET_CLOSE) {
+		ChainCompaction::SignalHandler handler;
+		handler.sigid = current.data.number;
+		matchToken(tokens, current, InputTokenizer::Lexeme::TKN_NUMBER);
+
+		matchToken(tokens, current, InputTokenizer::Lexeme::TKN_ARROW);
+
+		Addr addr = current.data.addr;
+		matchToken(tokens, current, InputTokenizer::Lexeme::TKN_ADDR);
+
+		handler.handler = function(reader, addr);
+		handler.count = readCount(tokens, current);
+		member.signalHandlers.push_back(handler);
+	}
+	matchToken(tokens, current, InputTokenizer::Lexeme::TKN_BRACKET_CLOSE);
+
+	member.indirect = current.data.boolean;
+	matchToken(tokens, current, InputTokenizer::Lexeme::TKN_BOOL);
+
+	matchToken(tokens, current, InputTokenizer::Lexeme::TKN_BRACKET_CLOSE);
+
+	return member;
+}
+
+std::map<Addr, std::vector<ChainCompaction::Chain>> ChainCompaction::read(
+		std::istream& input, const CFGReader& reader) {
+	std::map<Addr, std::vector<Chain>> chains;
+
+	InputTokenizer tokens(input);
+	InputTokenizer::Lexeme current = tokens.nextToken();
+	while (current.type == InputTokenizer::Lexeme::TKN_BRACKET_OPEN) {
+		matchToken(tokens, current, InputTokenizer::Lexeme::TKN_BRACKET_OPEN);
+
+		if (current.token != "chain")
+			throw std::string("Invalid chain mapping record: ") + current.token;
+		matchToken(tokens, current, InputTokenizer::Lexeme::TKN_KEYWORD);
+
+		Addr addr = current.data.addr;
+		matchToken(tokens, current, InputTokenizer::Lexeme::TKN_ADDR);
+
+		Chain chain;
+		matchToken(tokens, current, InputTokenizer::Lexeme::TKN_BRACKET_OPEN);
+		while (current.type != InputTokenizer::Lexeme::TKN_BRACKET_CLOSE)
+			chain.members.push_back(readMember(tokens, current, reader));
+		matchToken(tokens, current, InputTokenizer::Lexeme::TKN_BRACKET_CLOSE);
+
+		matchToken(tokens, current, InputTokenizer::Lexeme::TKN_BRACKET_OPEN);
+		while (current.type != InputTokenizer::Lexeme::TKN_BRACKET_CLOSE) {
+			chain.counts.push_back(current.data.number);
+			matchToken(tokens, current, InputTokenizer::Lexeme::TKN_NUMBER);
+		}
+		matchToken(tokens, current, InputTokenizer::Lexeme::TKN_BRACKET_CLOSE);
+
+		matchToken(tokens, current, InputTokenizer::Lexeme::TKN_BRACKET_CLOSE);
+
+		if (chain.members.size() < 2 || chain.counts.size() + 1 != chain.members.size())
+			throw std::string("Invalid chain mapping: wrong number of members or counts");
+
+		chains[addr].push_back(chain);
+	}
+
+	if (current.type != InputTokenizer::Lexeme::TKN_EOF)
+		throw std::string("Invalid chain mapping near: ") + current.token;
+
+	return chains;
+}
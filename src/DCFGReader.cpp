@@ -21,33 +21,41 @@
 */
 
 #include <list>
+#include <mutex>
 #include <string>
+#include <stdexcept>
 #include <CFG.h>
 #include <CfgNode.h>
+#include <ThreadPool.h>
+#include <MemoryUsage.h>
 #include <DCFGReader.h>
 
 using json = nlohmann::json;
 
 DCFGReader::DCFGReader(const std::string& filename)
-	: CFGReader(filename) {
+	: CFGReader(filename), m_useRoutines(false), m_parse() {
+}
+
+DCFGReader::DCFGReader(std::istream* input)
+	: CFGReader(input), m_useRoutines(false), m_parse() {
 }
 
 DCFGReader::~DCFGReader() {
 }
 
+// Malformed documents are reported like the other readers do.
 static
-std::vector<std::string> readStrings(json& obj, const std::string& field) {
+void expect(bool valid, const std::string& what) {
+	if (!valid)
+		throw std::string("Invalid dcfg format: ") + what;
+}
+
+static
+std::vector<std::string> readStrings(json& array) {
 	json::iterator it, ed;
 	std::vector<std::string> container;
 
-	assert(obj.is_object());
-
-	ed = obj.end();
-	it = obj.find(field);
-	assert(it != ed);
-
-	json& array = it.value();
-	assert(array.is_array());
+	expect(array.is_array(), "expected an array of strings");
 
 	for (it = ++(array.begin()), ed = array.end(); it != ed; ++it) {
 		int id = (*it).at(0);
@@ -61,9 +69,63 @@ std::vector<std::string> readStrings(json& obj, const std::string& field) {
 	return container;
 }
 
-void DCFGReader::buildCFG(int entry) {
+bool DCFGReader::hasNode(int id) const {
+	return id >= 0 && id < (int) m_nodes.size() && m_nodes[id].addr != 0;
+}
+
+CfgNode* DCFGReader::nodeWithId(CFG* cfg, BuildState& state, int id) {
+	assert(hasNode(id));
+
+	if (state.nodesEpoch[id] != state.epoch) {
+		state.nodesEpoch[id] = state.epoch;
+		state.cfgNodes[id] = CFGReader::nodeWithAddr(cfg, m_nodes[id].addr);
+	}
+
+	return state.cfgNodes[id];
+}
+
+void DCFGReader::buildEdges() {
+	// Count the edges of each node and turn the counts into offsets.
+	m_edgesIndex.assign(m_nodes.size() + 1, 0);
+	for (const std::pair<int, Edge>& raw : m_rawEdges) {
+		expect(raw.first >= 0, "negative edge source");
+		if (raw.first >= (int) m_nodes.size()) {
+			m_nodes.resize(raw.first + 1);
+			m_edgesIndex.resize(m_nodes.size() + 1, 0);
+		}
+
+		m_edgesIndex[raw.first + 1]++;
+	}
+
+	for (std::vector<unsigned>::size_type i = 1; i < m_edgesIndex.size(); i++)
+		m_edgesIndex[i] += m_edgesIndex[i - 1];
+
+	// Place the edges keeping the order they were read.
+	std::vector<unsigned> next(m_edgesIndex.begin(), m_edgesIndex.end() - 1);
+	m_edges.resize(m_rawEdges.size());
+	for (const std::pair<int, Edge>& raw : m_rawEdges)
+		m_edges[next[raw.first]++] = raw.second;
+
+	std::vector<std::pair<int, Edge>>().swap(m_rawEdges);
+
+	m_visited.assign(m_nodes.size(), false);
+}
+
+void DCFGReader::initState(BuildState& state) const {
+	state.epoch = 0;
+	state.visitedEpoch.assign(m_nodes.size(), 0);
+	state.nodesEpoch.assign(m_nodes.size(), 0);
+	state.cfgNodes.assign(m_nodes.size(), 0);
+}
+
+void DCFGReader::buildCFG(int entry, BuildState& state, const Routine* routine,
+					std::list<CrossEdge>* deferred) {
+	assert(hasNode(entry));
 	CFG* cfg = this->instance(m_nodes[entry].addr);
 
+	// Start a new epoch, invalidating the marks of the previous CFG.
+	state.epoch++;
+
 	// Add special entry node.
 	assert(cfg->entryNode() == 0);
 	CfgNode* entry_node = new CfgNode(CfgNode::CFG_ENTRY);
@@ -71,34 +133,38 @@ void DCFGReader::buildCFG(int entry) {
 
 	// Add the first node.
 	assert(cfg->nodeByAddr(m_nodes[entry].addr) == 0);
-	cfg->addEdge(entry_node, CFGReader::nodeWithAddr(cfg, m_nodes[entry].addr),
-					cfg->execs());
+	cfg->addEdge(entry_node, this->nodeWithId(cfg, state, entry), cfg->execs());
 
-	std::set<int> visited;
-	std::list<int> worklist;
+	std::vector<int> worklist;
 	worklist.push_back(entry);
 
-	while (!worklist.empty()) {
-		int src_id = worklist.front();
-		worklist.pop_front();
-		assert(src_id > 3);
+	for (std::vector<int>::size_type i = 0; i < worklist.size(); i++) {
+		int src_id = worklist[i];
+		expect(src_id > 3, "edge into a special node");
 
-		if (visited.find(src_id) != visited.cend())
+		if (state.visitedEpoch[src_id] == state.epoch)
 			continue;
-		visited.insert(src_id);
+		state.visitedEpoch[src_id] = state.epoch;
+
+		const DCFGReader::Node& src_bb = m_nodes[src_id];
+		CfgNode* src_node = this->nodeWithId(cfg, state, src_id);
+		assert(src_node != 0);
+		cfg->promotePhantom(src_node, src_bb.size);
 
-		DCFGReader::Node& src_bb = m_nodes[src_id];
-		CfgNode* src_node = cfg->nodeByAddr(src_bb.addr);
-		assert(src_node != 0 && src_node->type() == CfgNode::CFG_PHANTOM);
-		src_node->setData(new CfgNode::BlockData(src_bb.addr, src_bb.size));
+		for (unsigned e = m_edgesIndex[src_id], ed = m_edgesIndex[src_id + 1];
+				e != ed; e++) {
+			const DCFGReader::Edge& edge = m_edges[e];
 
-		for (DCFGReader::Edge& edge : m_edges[src_id]) {
 			// Ignore unknown node.
 			if (edge.dst_id == UNKNOWN_NODE)
 				continue;
 
-			std::map<int, Node>::const_iterator it = m_nodes.find(edge.dst_id);
-			Addr dst_addr = (it != m_nodes.end() ? (it->second).addr : 0);
+			// Nodes from images that were not loaded are not in the table.
+			bool known = hasNode(edge.dst_id);
+			Addr dst_addr = (known ? m_nodes[edge.dst_id].addr : 0);
+
+			// When building from a routine, only follow its own blocks.
+			bool follow = (routine == 0 || routine->bbs.count(edge.dst_id) > 0);
 
 			unsigned long long count = edge.count;
 
@@ -112,146 +178,367 @@ void DCFGReader::buildCFG(int entry) {
 				case DIRECT_UNCONDITIONAL_BRANCH_EDGE:
 				case FALL_THROUGH_EDGE:
 				case EXCLUDED_CODE_BYPASS_EDGE:
-					cfg->addEdge(src_node, CFGReader::nodeWithAddr(cfg, dst_addr), count);
-					worklist.push_back(edge.dst_id);
+					if (!known)
+						break;
+
+					cfg->addEdge(src_node, this->nodeWithId(cfg, state, edge.dst_id), count);
+					if (follow)
+						worklist.push_back(edge.dst_id);
 					break;
 				case DIRECT_CONDITIONAL_BRANCH_EDGE:
-					cfg->addEdge(src_node, CFGReader::nodeWithAddr(cfg, dst_addr), count);
+					if (known) {
+						cfg->addEdge(src_node, this->nodeWithId(cfg, state, edge.dst_id), count);
+						if (follow)
+							worklist.push_back(edge.dst_id);
+					}
 					cfg->addEdge(src_node, CFGReader::nodeWithAddr(cfg, src_bb.addr + src_bb.size));
-					worklist.push_back(edge.dst_id);
 					break;
 				case INDIRECT_CALL_EDGE:
 					CFGReader::markIndirect(src_node);
 					// fallthrough
 				case SYSTEM_CALL_EDGE:
-				case DIRECT_CALL_EDGE: {
-					CFG* called = this->instance(dst_addr);
-					CFGReader::addCall(src_node, called, count,
-						m_visited.find(src_id) == m_visited.cend());
+				case DIRECT_CALL_EDGE:
+				case CONTEXT_CHANGE_EDGE: {
+					if (!known)
+						break;
+
+					CrossEdge cross = { src_id, src_node, edge.edge_type, dst_addr, count };
+					if (deferred)
+						deferred->push_back(cross);
+					else
+						this->applyCrossEdge(cross, !m_visited[src_id]);
 					} break;
 				case EXIT_EDGE:
 					// The destination must be the special exit node (2).
-					assert(edge.dst_id == 2);
+					expect(edge.dst_id == 2, "exit edge not leading to the exit node");
 					cfg->addEdge(src_node, CFGReader::haltNode(cfg), count);
 					break;
 				case RETURN_EDGE:
 					cfg->addEdge(src_node, CFGReader::exitNode(cfg), count);
 					break;
-				case CONTEXT_CHANGE_EDGE: {
-					CFG* sigHandler = this->instance(dst_addr);
-					CFGReader::addSignalHandler(src_node, 0, sigHandler, count,
-						m_visited.find(src_id) == m_visited.cend());
-
-					} break;
-				default: {
-					// std::vector<std::string> edgeTypes = readStrings(obj, "EDGE_TYPES");
-					// std::cout << "edge type: " << edgeTypes[edge.edge_type] << "\n";
-					assert(false);
-					} break;
+				default:
+					expect(false, "unknown edge type " + std::to_string(edge.edge_type));
+					break;
 			}
 		}
 
 		// Added to the global visited ids.
-		m_visited.insert(src_id);
+		if (!deferred)
+			m_visited[src_id] = true;
+	}
+}
+
+void DCFGReader::applyCrossEdge(const CrossEdge& cross, bool update) {
+	if (cross.edge_type == CONTEXT_CHANGE_EDGE) {
+		CFG* sigHandler = this->instance(cross.dst_addr);
+		CFGReader::addSignalHandler(cross.src_node, 0, sigHandler,
+			cross.count, update);
+	} else {
+		CFG* called = this->instance(cross.dst_addr);
+		CFGReader::addCall(cross.src_node, called, cross.count, update);
+	}
+}
+
+void DCFGReader::buildCFGs() {
+	BuildState state;
+	this->initState(state);
+
+	for (int entry : m_entries) {
+		// The entry may be in an image that was not loaded.
+		if (hasNode(entry))
+			this->buildCFG(entry, state);
+	}
+}
+
+void DCFGReader::buildRoutineCFGs() {
+	struct Task {
+		int entry;
+		const Routine* routine;
+		std::list<CrossEdge> deferred;
+	};
+
+	// One CFG per routine, in the order they were read, followed by the
+	// entries not covered by any routine.
+	std::list<Task> tasks;
+	std::set<int> built;
+	for (const Routine& r : m_routines) {
+		if (hasNode(r.entry_bb) && built.insert(r.entry_bb).second)
+			tasks.push_back((Task) { r.entry_bb, &r, std::list<CrossEdge>() });
+	}
+
+	for (int entry : m_entries) {
+		if (hasNode(entry) && built.insert(entry).second)
+			tasks.push_back((Task) { entry, 0, std::list<CrossEdge>() });
+	}
+
+	// Build the CFGs independently. Each worker reuses its build state
+	// across tasks, taking it from a shared free list.
+	std::mutex statesMutex;
+	std::list<BuildState> states;
+	std::list<BuildState*> freeStates;
+
+	ThreadPool pool(m_jobs);
+	for (Task& task : tasks) {
+		pool.submit([this, &task, &states, &freeStates, &statesMutex] {
+			BuildState* state;
+			{
+				std::lock_guard<std::mutex> lock(statesMutex);
+				if (freeStates.empty()) {
+					states.push_back(BuildState());
+					state = &states.back();
+					this->initState(*state);
+				} else {
+					state = freeStates.front();
+					freeStates.pop_front();
+				}
+			}
+
+			this->buildCFG(task.entry, *state, task.routine, &task.deferred);
+
+			std::lock_guard<std::mutex> lock(statesMutex);
+			freeStates.push_back(state);
+		});
+	}
+	pool.wait();
+
+	// Apply the calls and context changes in a deterministic order. As
+	// in the sequential construction, the callee is only updated the
+	// first time the calling block is found.
+	for (Task& task : tasks) {
+		for (std::list<CrossEdge>::const_iterator it = task.deferred.cbegin(),
+				ed = task.deferred.cend(); it != ed; ) {
+			int src_id = it->src_id;
+			bool update = !m_visited[src_id];
+
+			for (; it != ed && it->src_id == src_id; ++it)
+				this->applyCrossEdge(*it, update);
+
+			m_visited[src_id] = true;
+		}
 	}
 }
 
 void DCFGReader::loadCFGs() {
-	json obj;
+	this->startPhases();
 
 	// We consider the first block (4, the first id after the special ones)
 	// as an CFG entry.
 	m_entries.insert(4);
 
-	m_input >> obj;
+	// The processes are read into the tables while parsing, so their
+	// JSON values are never kept in the document.
+	m_parse = ParseState();
+	json obj = json::parse(m_input,
+		[this](int depth, json::parse_event_t event, json& parsed) {
+			return this->parseEvent(depth, event, parsed);
+		});
+	obj = json();
+
+	// Images read before the file names were known.
+	for (json& row : m_pendingImages) {
+		if (this->selectImage(row.at(3).at("FILE_NAME_ID")))
+			readImage(row);
+	}
+	std::list<json>().swap(m_pendingImages);
+
+	MemoryUsage::trim();
+	buildEdges();
+	this->endPhase("parse");
 
-	m_filenames = readStrings(obj, "FILE_NAMES");
-	readProcesses(obj);
+	if (m_useRoutines)
+		this->buildRoutineCFGs();
+	else
+		this->buildCFGs();
 
-	for (int entry : m_entries)
-		this->buildCFG(entry);
+	// The CFGs are built, drop the tables.
+	this->releaseTables();
+	this->endPhase("build");
 
-	for (CFG* cfg : this->cfgs())
-		cfg->check();
+	this->checkCFGs();
+	this->endPhase("check");
+}
+
+void DCFGReader::releaseTables() {
+	std::vector<Node>().swap(m_nodes);
+	std::vector<unsigned>().swap(m_edgesIndex);
+	std::vector<Edge>().swap(m_edges);
+	std::list<Routine>().swap(m_routines);
+	std::map<Addr, Symbol>().swap(m_symbols);
+	std::set<int>().swap(m_entries);
+	std::vector<bool>().swap(m_visited);
+
+	MemoryUsage::trim();
 }
 
 static
 Addr str2addr(const std::string& str) {
-	assert(str.compare(0, 2, "0x") == 0);
-	Addr addr = std::stoul(str.substr(2), 0, 16);
-	assert(addr != 0);
+	Addr addr = 0;
+	if (str.compare(0, 2, "0x") == 0) {
+		try {
+			addr = std::stoul(str.substr(2), 0, 16);
+		} catch (const std::logic_error&) {
+		}
+	}
+	expect(addr != 0, "invalid address " + str);
 
 	return addr;
 }
 
-void DCFGReader::readProcesses(json& obj) {
-	json::iterator it, ed;
+bool DCFGReader::selectProcess(long pid) const {
+	return m_processes.empty() || m_processes.count(pid) > 0;
+}
 
-	assert(obj.is_object());
+bool DCFGReader::selectImage(int file_id) const {
+	if (m_images.empty())
+		return true;
 
-	ed = obj.end();
-	it = obj.find("PROCESSES");
-	assert(it != ed);
+	if (file_id < 0 || file_id >= (int) m_filenames.size())
+		return false;
 
-	json& array = it.value();
-	assert(array.is_array());
+	const std::string& name = m_filenames[file_id];
+	if (m_images.count(name) > 0)
+		return true;
 
-	for (it = ++(array.begin()), ed = array.end(); it != ed; ++it) {
-		json& pdata = (*it).at(1);
-		assert(pdata.is_object());
+	std::string::size_type n = name.rfind('/');
+	return (n != std::string::npos && m_images.count(name.substr(n + 1)) > 0);
+}
 
-		json::iterator it2;
-		it2 = pdata.find("IMAGES");
-		assert(it2 != pdata.end());
-		readImages(it2.value());
+// The document is laid out as (depth of each level in brackets):
+// { [1] "FILE_NAMES": [...], "PROCESSES": [ [2] [pid, [3] { [4]
+//     "IMAGES": [ [5] [id, addr, size, [6] { [7] "FILE_NAME_ID": id, ... } ] ],
+//     "EDGES": [ [5] [id, src, dst, type, counts] ] } ] ] }
+bool DCFGReader::parseEvent(int depth, json::parse_event_t event, json& parsed) {
+	ParseState& ps = m_parse;
+
+	if (event == json::parse_event_t::key) {
+		if ((int) ps.keys.size() <= depth)
+			ps.keys.resize(depth + 1);
+		ps.keys[depth] = parsed.get<std::string>();
+	}
 
-		it2 = pdata.find("EDGES");
-		assert(it2 != pdata.end());
-		readEdges(it2.value());
+	bool processes = (ps.keys.size() > 1 && ps.keys[1] == "PROCESSES");
+	if (depth == 1 && event == json::parse_event_t::array_end) {
+		if (ps.keys[1] == "FILE_NAMES") {
+			m_filenames = readStrings(parsed);
+			return false;
+		}
 	}
-}
 
-void DCFGReader::readImages(json& array) {
-	json::iterator it, ed;
+	if (!processes || depth < 2)
+		return true;
+
+	if (depth == 2) {
+		if (event == json::parse_event_t::array_start) {
+			ps.pidKnown = false;
+			ps.processSelected = m_processes.empty();
+			ps.imagesRead = false;
+		} else if (event == json::parse_event_t::array_end) {
+			// Everything needed was already read.
+			return false;
+		}
 
-	assert(array.is_array());
+		return true;
+	}
 
-	for (it = ++(array.begin()), ed = array.end(); it != ed; ++it) {
-		Addr baseAddr = str2addr((*it).at(1));
+	if (depth == 3) {
+		if (event == json::parse_event_t::value && !ps.pidKnown &&
+				parsed.is_number_integer()) {
+			ps.pidKnown = true;
+			ps.processSelected = this->selectProcess(parsed.get<long>());
+		} else if (event == json::parse_event_t::object_start) {
+			// Skip the images and edges of the other processes.
+			return ps.processSelected;
+		}
 
-		json& idata = (*it).at(3);
-		assert(idata.is_object());
+		return true;
+	}
 
-		json::iterator it2 = idata.find("FILE_NAME_ID");
-		assert(it2 != idata.end());
-		int file_id = it2.value();
+	bool images = (ps.keys.size() > 4 && ps.keys[4] == "IMAGES");
+	bool edges = (ps.keys.size() > 4 && ps.keys[4] == "EDGES");
+
+	if (images) {
+		if (depth == 4 && event == json::parse_event_t::array_end) {
+			ps.imagesRead = true;
+		} else if (depth == 5 && event == json::parse_event_t::array_start) {
+			ps.fileId = -1;
+			ps.imageSelected = true;
+		} else if (depth == 5 && event == json::parse_event_t::array_end) {
+			// Ignore the header row.
+			if (parsed.size() < 4 || !parsed[3].is_object())
+				return false;
+
+			if (ps.fileId >= 0 && !m_images.empty() && m_filenames.empty())
+				m_pendingImages.push_back(parsed);
+			else if (ps.imageSelected)
+				readImage(parsed);
+
+			return false;
+		} else if (depth == 7 && event == json::parse_event_t::value &&
+				ps.keys.size() > 7 && ps.keys[7] == "FILE_NAME_ID") {
+			ps.fileId = parsed.get<int>();
+			ps.imageSelected = (m_filenames.empty() || this->selectImage(ps.fileId));
+		} else if (depth == 7 && event == json::parse_event_t::key) {
+			// Skip the sections of the other images. The decision can only
+			// be made if the file name id comes before them.
+			return ps.imageSelected;
+		}
+	} else if (edges) {
+		if (depth == 5 && event == json::parse_event_t::array_end) {
+			// Ignore the header row.
+			if (parsed.size() < 5 || !parsed[0].is_number())
+				return false;
+
+			// Only store the edges leaving loaded blocks, if they are known.
+			int src = parsed.at(1);
+			readEdge(parsed, m_images.empty() || m_filenames.empty() ||
+				!ps.imagesRead || hasNode(src));
+
+			return false;
+		}
+	}
 
-		it2 = idata.find("BASIC_BLOCKS");
-		if (it2 != idata.end())
-			readBasicBlocks(baseAddr, it2.value());
+	return true;
+}
 
-		it2 = idata.find("ROUTINES");
-		if (it2 != idata.end())
-			readRoutines(it2.value());
+void DCFGReader::readImage(json& row) {
+	Addr baseAddr = str2addr(row.at(1));
 
-		it2 = idata.find("SYMBOLS");
-		if (it2 != idata.end())
-			readSymbols(file_id, baseAddr, it2.value());
+	json& idata = row.at(3);
+	expect(idata.is_object(), "expected an image object");
 
-		it2 = idata.find("SOURCE_DATA");
-		if (it2 != idata.end())
-			readSourceData(file_id, baseAddr, it2.value());
-	}
+	json::iterator it = idata.find("FILE_NAME_ID");
+	expect(it != idata.end(), "image without FILE_NAME_ID");
+	int file_id = it.value();
+
+	it = idata.find("BASIC_BLOCKS");
+	if (it != idata.end())
+		readBasicBlocks(baseAddr, it.value());
+
+	it = idata.find("ROUTINES");
+	if (it != idata.end())
+		readRoutines(it.value());
+
+	it = idata.find("SYMBOLS");
+	if (it != idata.end())
+		readSymbols(file_id, baseAddr, it.value());
+
+	it = idata.find("SOURCE_DATA");
+	if (it != idata.end())
+		readSourceData(file_id, baseAddr, it.value());
 }
 
 void DCFGReader::readBasicBlocks(Addr baseAddr, json& array) {
 	json::iterator it, ed;
 
-	assert(array.is_array());
+	expect(array.is_array(), "expected an array of basic blocks");
 
 	for (it = ++(array.begin()), ed = array.end(); it != ed; ++it) {
 		Addr addr = str2addr((*it).at(1));
 		int id = (*it).at(0);
+		expect(id >= 0, "negative basic block id");
+		if (id >= (int) m_nodes.size())
+			m_nodes.resize(id + 1, (DCFGReader::Node) { 0, 0, 0, 0 });
+
 		m_nodes[id] = (DCFGReader::Node) {
 			.addr = baseAddr + addr,
 			.size = (*it).at(2),
@@ -264,7 +551,7 @@ void DCFGReader::readBasicBlocks(Addr baseAddr, json& array) {
 void DCFGReader::readRoutines(json& array) {
 	json::iterator it, ed;
 
-	assert(array.is_array());
+	expect(array.is_array(), "expected an array of routines");
 
 	for (it = ++(array.begin()), ed = array.end(); it != ed; ++it) {
 		json::iterator it2, ed2;
@@ -273,12 +560,12 @@ void DCFGReader::readRoutines(json& array) {
 		r.entry_bb = (*it).at(0);
 
 		json& tmp = (*it).at(1);
-		assert(tmp.is_array());
+		expect(tmp.is_array(), "expected an array of routine exits");
 		for (json& element : tmp)
 			r.exit_bbs.insert(static_cast<int>(element));
 
 		tmp = (*it).at(2);
-		assert(tmp.is_array());
+		expect(tmp.is_array(), "expected an array of routine blocks");
 
 		for (it2 = ++(tmp.begin()), ed2 = tmp.end(); it2 != ed2; ++it2)
 			r.bbs.insert(static_cast<int>((*it2).at(0)));
@@ -290,7 +577,7 @@ void DCFGReader::readRoutines(json& array) {
 void DCFGReader::readSymbols(int file_id, Addr baseAddr, json& array) {
 	json::iterator it, ed;
 
-	assert(array.is_array());
+	expect(array.is_array(), "expected an array of symbols");
 
 	for (it = ++(array.begin()), ed = array.end(); it != ed; ++it) {
 		Addr addr = str2addr((*it).at(1));
@@ -305,7 +592,7 @@ void DCFGReader::readSymbols(int file_id, Addr baseAddr, json& array) {
 void DCFGReader::readSourceData(int file_id, Addr baseAddr, json& array) {
 	json::iterator it, ed;
 
-	assert(array.is_array());
+	expect(array.is_array(), "expected an array of source data");
 
 	for (it = ++(array.begin()), ed = array.end(); it != ed; ++it) {
 		Addr addr = str2addr((*it).at(2));
@@ -318,40 +605,36 @@ void DCFGReader::readSourceData(int file_id, Addr baseAddr, json& array) {
 	}
 }
 
-void DCFGReader::readEdges(json& array) {
-	json::iterator it, ed;
-
-	assert(array.is_array());
+void DCFGReader::readEdge(json& row, bool store) {
+	int src = row.at(1);
+	int dst = row.at(2);
+	int etype = row.at(3);
+	json& counts = row.at(4);
 
-	for (it = ++(array.begin()), ed = array.end(); it != ed; ++it) {
-		int src = (*it).at(1);
-		int dst = (*it).at(2);
-		int etype = (*it).at(3);
-		json& counts = (*it).at(4);
-
-		json::iterator it2, ed2;
-		unsigned long long count = 0;
-		for (it2 = counts.begin(), ed2 = counts.end(); it2 != ed2; ++it2)
-			count += static_cast<int>(*it2);
+	json::iterator it, ed;
+	unsigned long long count = 0;
+	for (it = counts.begin(), ed = counts.end(); it != ed; ++it)
+		count += static_cast<int>(*it);
 
-		m_edges[src].push_back((DCFGReader::Edge) {
+	if (store) {
+		m_rawEdges.push_back(std::make_pair(src, (DCFGReader::Edge) {
 			.dst_id = dst,
 			.edge_type = etype,
 			.count = count
-		});
+		}));
+	}
 
-		if (dst > 3) {
-			// Targets of call and context changes are CFG entries.
-			switch (etype) {
-				case INDIRECT_CALL_EDGE:
-				case SYSTEM_CALL_EDGE:
-				case DIRECT_CALL_EDGE:
-				case CONTEXT_CHANGE_EDGE:
-					m_entries.insert(dst);
-					break;
-				default:
-					break;
-			}
+	if (dst > 3) {
+		// Targets of call and context changes are CFG entries.
+		switch (etype) {
+			case INDIRECT_CALL_EDGE:
+			case SYSTEM_CALL_EDGE:
+			case DIRECT_CALL_EDGE:
+			case CONTEXT_CHANGE_EDGE:
+				m_entries.insert(dst);
+				break;
+			default:
+				break;
 		}
 	}
 }
@@ -0,0 +1,266 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#include <cassert>
+#include <sstream>
+#include <algorithm>
+
+#include <CFG.h>
+#include <CfgNode.h>
+#include <DominatorTree.h>
+
+DominatorTree::DominatorTree(const CFG* cfg, bool post) : m_cfg(cfg), m_post(post) {
+	this->number();
+	this->compute();
+	this->intervals();
+}
+
+DominatorTree::~DominatorTree() {
+}
+
+static
+bool isSink(CfgNode* node) {
+	switch (node->type()) {
+		case CfgNode::CFG_EXIT:
+		case CfgNode::CFG_HALT:
+		case CfgNode::CFG_PHANTOM:
+			return true;
+		default:
+			return false;
+	}
+}
+
+// Depth-first search from the root following the successors (or the
+// predecessors for post-dominators), numbering the nodes in reverse
+// postorder. The virtual sink is represented by a null node.
+void DominatorTree::number() {
+	std::vector<CfgNode*> postorder;
+	std::vector<std::pair<CfgNode*, std::vector<CfgNode*>>> stack;
+	std::unordered_map<CfgNode*, bool> visited;
+
+	std::vector<CfgNode*> roots;
+	if (m_post) {
+		for (CfgNode* node : m_cfg->nodes()) {
+			if (isSink(node))
+				roots.push_back(node);
+		}
+		std::sort(roots.begin(), roots.end(), CfgNode::nodeOrder);
+	} else if (m_cfg->entryNode()) {
+		roots.push_back(m_cfg->entryNode());
+	}
+
+	for (CfgNode* root : roots) {
+		if (visited[root])
+			continue;
+
+		visited[root] = true;
+		stack.push_back(std::make_pair(root, std::vector<CfgNode*>()));
+		const std::set<CfgNode*>& next = (m_post ? m_cfg->predecessors(root) :
+			m_cfg->successors(root));
+		stack.back().second.assign(next.cbegin(), next.cend());
+		std::sort(stack.back().second.begin(), stack.back().second.end(),
+			CfgNode::nodeOrder);
+		std::reverse(stack.back().second.begin(), stack.back().second.end());
+
+		while (!stack.empty()) {
+			std::vector<CfgNode*>& pending = stack.back().second;
+			if (pending.empty()) {
+				postorder.push_back(stack.back().first);
+				stack.pop_back();
+				continue;
+			}
+
+			CfgNode* node = pending.back();
+			pending.pop_back();
+			if (visited[node])
+				continue;
+
+			visited[node] = true;
+			stack.push_back(std::make_pair(node, std::vector<CfgNode*>()));
+			const std::set<CfgNode*>& next = (m_post ? m_cfg->predecessors(node) :
+				m_cfg->successors(node));
+			stack.back().second.assign(next.cbegin(), next.cend());
+			std::sort(stack.back().second.begin(), stack.back().second.end(),
+				CfgNode::nodeOrder);
+			std::reverse(stack.back().second.begin(), stack.back().second.end());
+		}
+	}
+
+	if (m_post)
+		postorder.push_back(0);
+
+	m_nodes.assign(postorder.rbegin(), postorder.rend());
+	for (std::vector<CfgNode*>::size_type i = 0; i < m_nodes.size(); i++)
+		m_index[m_nodes[i]] = i;
+}
+
+std::vector<int> DominatorTree::predecessors(int idx) const {
+	std::vector<int> preds;
+
+	CfgNode* node = m_nodes[idx];
+	if (node == 0)
+		return preds;
+
+	const std::set<CfgNode*>& nodes = (m_post ? m_cfg->successors(node) :
+		m_cfg->predecessors(node));
+	for (CfgNode* pred : nodes) {
+		std::unordered_map<CfgNode*, int>::const_iterator it = m_index.find(pred);
+		if (it != m_index.end())
+			preds.push_back(it->second);
+	}
+
+	if (m_post && isSink(node))
+		preds.push_back(0);
+
+	return preds;
+}
+
+int DominatorTree::intersect(int b1, int b2) const {
+	// Nodes are numbered in reverse postorder, so dominators have
+	// smaller numbers.
+	while (b1 != b2) {
+		while (b1 > b2)
+			b1 = m_idom[b1];
+		while (b2 > b1)
+			b2 = m_idom[b2];
+	}
+
+	return b1;
+}
+
+void DominatorTree::compute() {
+	m_idom.assign(m_nodes.size(), -1);
+	if (m_nodes.empty())
+		return;
+
+	std::vector<std::vector<int>> preds(m_nodes.size());
+	for (std::vector<CfgNode*>::size_type i = 1; i < m_nodes.size(); i++)
+		preds[i] = this->predecessors(i);
+
+	m_idom[0] = 0;
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (std::vector<CfgNode*>::size_type i = 1; i < m_nodes.size(); i++) {
+			int idom = -1;
+			for (int pred : preds[i]) {
+				if (m_idom[pred] == -1)
+					continue;
+
+				idom = (idom == -1 ? pred : this->intersect(pred, idom));
+			}
+
+			if (idom != m_idom[i]) {
+				m_idom[i] = idom;
+				changed = true;
+			}
+		}
+	}
+}
+
+void DominatorTree::intervals() {
+	m_pre.assign(m_nodes.size(), 0);
+	m_last.assign(m_nodes.size(), 0);
+	if (m_nodes.empty())
+		return;
+
+	std::vector<std::vector<int>> children(m_nodes.size());
+	for (std::vector<CfgNode*>::size_type i = 1; i < m_nodes.size(); i++)
+		children[m_idom[i]].push_back(i);
+
+	int counter = 0;
+	std::vector<std::pair<int, std::vector<int>::size_type>> stack;
+	m_pre[0] = counter++;
+	stack.push_back(std::make_pair(0, 0));
+	while (!stack.empty()) {
+		std::pair<int, std::vector<int>::size_type>& top = stack.back();
+		if (top.second < children[top.first].size()) {
+			int child = children[top.first][top.second++];
+			m_pre[child] = counter++;
+			stack.push_back(std::make_pair(child, 0));
+		} else {
+			m_last[top.first] = counter - 1;
+			stack.pop_back();
+		}
+	}
+}
+
+CfgNode* DominatorTree::root() const {
+	return (m_nodes.empty() ? 0 : m_nodes[0]);
+}
+
+bool DominatorTree::contains(CfgNode* node) const {
+	return m_index.count(node) > 0;
+}
+
+CfgNode* DominatorTree::immediateDominator(CfgNode* node) const {
+	std::unordered_map<CfgNode*, int>::const_iterator it = m_index.find(node);
+	if (it == m_index.end() || it->second == 0)
+		return 0;
+
+	return m_nodes[m_idom[it->second]];
+}
+
+std::vector<CfgNode*> DominatorTree::children(CfgNode* node) const {
+	std::vector<CfgNode*> children;
+
+	std::unordered_map<CfgNode*, int>::const_iterator it = m_index.find(node);
+	if (it == m_index.end())
+		return children;
+
+	for (std::vector<CfgNode*>::size_type i = 1; i < m_nodes.size(); i++) {
+		if (m_idom[i] == it->second)
+			children.push_back(m_nodes[i]);
+	}
+
+	return children;
+}
+
+bool DominatorTree::dominates(CfgNode* dom, CfgNode* node) const {
+	std::unordered_map<CfgNode*, int>::const_iterator d = m_index.find(dom);
+	std::unordered_map<CfgNode*, int>::const_iterator n = m_index.find(node);
+	assert(d != m_index.end() && n != m_index.end());
+
+	return m_pre[d->second] <= m_pre[n->second] &&
+		m_pre[n->second] <= m_last[d->second];
+}
+
+std::string DominatorTree::str() const {
+	std::stringstream ss;
+
+	std::vector<CfgNode*> nodes;
+	for (CfgNode* node : m_nodes) {
+		if (node != 0 && node != this->root())
+			nodes.push_back(node);
+	}
+	std::sort(nodes.begin(), nodes.end(), CfgNode::nodeOrder);
+
+	for (CfgNode* node : nodes) {
+		CfgNode* idom = this->immediateDominator(node);
+		ss << (m_post ? "[pdom 0x" : "[dom 0x") << std::hex << m_cfg->addr()
+		   << " " << CfgNode::node2name(node) << " "
+		   << (idom ? CfgNode::node2name(idom) : "sink") << "]" << std::endl;
+	}
+
+	return ss.str();
+}
@@ -0,0 +1,446 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#include <queue>
+#include <limits>
+#include <cassert>
+#include <sstream>
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+
+#include <CFG.h>
+#include <CfgEdge.h>
+#include <CfgNode.h>
+#include <FlowRepair.h>
+#include <ThreadPool.h>
+
+FlowRepair::FlowRepair(unsigned jobs) : m_jobs(jobs) {
+}
+
+FlowRepair::~FlowRepair() {
+}
+
+namespace {
+
+// Residual network solved by primal-dual: Dijkstra over reduced costs
+// raises the potentials, then depth-first augmentations saturate the
+// shortest paths over the arcs left with zero reduced cost. The costs are
+// small integers, so there are few distinct path lengths to go through.
+// All the arc costs start non-negative.
+class Network {
+public:
+	static const long long INFINITE = std::numeric_limits<long long>::max() / 4;
+
+	Network(unsigned size) : m_arcs(size), m_potential(size), m_state(size), m_current(size) {}
+
+	unsigned addArc(unsigned from, unsigned to, long long capacity, long long cost) {
+		assert(from != to);
+
+		Arc forward = { to, capacity, cost, (unsigned) m_arcs[to].size() };
+		Arc backward = { from, 0, -cost, (unsigned) m_arcs[from].size() };
+		m_arcs[from].push_back(forward);
+		m_arcs[to].push_back(backward);
+
+		return m_arcs[from].size() - 1;
+	}
+
+	long long flow(unsigned from, unsigned arc) const {
+		const Arc& a = m_arcs[from][arc];
+		return m_arcs[a.to][a.rev].capacity;
+	}
+
+	// Sends demand units from source to sink; false if they do not fit.
+	bool solve(unsigned source, unsigned sink, long long demand) {
+		std::fill(m_potential.begin(), m_potential.end(), 0);
+		while (demand > 0) {
+			if (!this->reprice(source, sink))
+				return false;
+
+			// Augment over the admissible arcs until none reaches the sink.
+			long long sent;
+			do {
+				sent = this->augment(source, sink, demand);
+				demand -= sent;
+			} while (demand > 0 && sent > 0);
+		}
+
+		return true;
+	}
+
+private:
+	enum State {
+		UNVISITED,
+		ON_PATH,
+		DEAD
+	};
+
+	struct Arc {
+		unsigned to;
+		long long capacity;
+		long long cost;
+		unsigned rev;
+	};
+
+	std::vector<std::vector<Arc>> m_arcs;
+	std::vector<long long> m_potential;
+	std::vector<char> m_state;
+	std::vector<unsigned> m_current;
+
+	bool admissible(unsigned from, const Arc& arc) const {
+		return arc.capacity > 0 &&
+			arc.cost + m_potential[from] - m_potential[arc.to] == 0;
+	}
+
+	// Raises the potentials by the shortest distances from the source;
+	// false if the sink is no longer reachable.
+	bool reprice(unsigned source, unsigned sink) {
+		unsigned size = m_arcs.size();
+		std::vector<long long> distance(size, INFINITE);
+
+		typedef std::pair<long long, unsigned> Item;
+		std::priority_queue<Item, std::vector<Item>, std::greater<Item>> queue;
+
+		distance[source] = 0;
+		queue.push(Item(0, source));
+		while (!queue.empty()) {
+			Item item = queue.top();
+			queue.pop();
+
+			unsigned u = item.second;
+			if (item.first > distance[u])
+				continue;
+
+			// Farther nodes are bounded by the sink distance anyway.
+			if (u == sink)
+				break;
+
+			for (const Arc& arc : m_arcs[u]) {
+				if (arc.capacity <= 0)
+					continue;
+
+				long long d = distance[u] + arc.cost + m_potential[u] - m_potential[arc.to];
+				if (d < distance[arc.to]) {
+					distance[arc.to] = d;
+					queue.push(Item(d, arc.to));
+				}
+			}
+		}
+
+		if (distance[sink] == INFINITE)
+			return false;
+
+		// Unreached nodes are bounded by the sink distance to keep
+		// the reduced costs non-negative.
+		for (unsigned v = 0; v < size; v++)
+			m_potential[v] += std::min(distance[v], distance[sink]);
+
+		return true;
+	}
+
+	// Pushes at most demand units over the admissible arcs by depth-first
+	// search, pruning the dead ends. The paths are walked iteratively since
+	// they may be as long as the function. Returns the units sent, zero
+	// only when no admissible path reaches the sink.
+	long long augment(unsigned source, unsigned sink, long long demand) {
+		std::fill(m_state.begin(), m_state.end(), UNVISITED);
+		std::fill(m_current.begin(), m_current.end(), 0);
+
+		std::vector<std::pair<unsigned, unsigned>> path;
+		long long sent = 0;
+
+		m_state[source] = ON_PATH;
+
+		unsigned u = source;
+		while (sent < demand) {
+			if (u == sink) {
+				long long amount = demand - sent;
+				for (const std::pair<unsigned, unsigned>& step : path)
+					amount = std::min(amount, m_arcs[step.first][step.second].capacity);
+
+				// Resume from the tail of the first saturated arc.
+				unsigned cut = path.size();
+				for (unsigned i = 0; i < path.size(); i++) {
+					Arc& arc = m_arcs[path[i].first][path[i].second];
+					arc.capacity -= amount;
+					m_arcs[arc.to][arc.rev].capacity += amount;
+					if (arc.capacity == 0 && cut == path.size())
+						cut = i;
+				}
+
+				sent += amount;
+				if (cut == path.size())
+					break;
+
+				for (unsigned i = cut; i < path.size(); i++)
+					m_state[m_arcs[path[i].first][path[i].second].to] = UNVISITED;
+
+				u = path[cut].first;
+				path.resize(cut);
+				continue;
+			}
+
+			unsigned& i = m_current[u];
+			while (i < m_arcs[u].size() &&
+					(m_state[m_arcs[u][i].to] != UNVISITED ||
+					 !this->admissible(u, m_arcs[u][i])))
+				i++;
+
+			if (i < m_arcs[u].size()) {
+				path.push_back(std::make_pair(u, i));
+				u = m_arcs[u][i].to;
+				m_state[u] = ON_PATH;
+			} else {
+				// Dead end: never enter it again in this search.
+				if (u == source)
+					break;
+
+				m_state[u] = DEAD;
+				u = path.back().first;
+				path.pop_back();
+				m_current[u]++;
+			}
+		}
+
+		return sent;
+	}
+
+};
+
+const long long Network::INFINITE;
+
+struct Adjustable {
+	CfgEdge* edge;
+	unsigned src;
+	unsigned dst;
+	// Increase and decrease arcs; -1 when missing.
+	int increase;
+	int decrease;
+};
+
+}
+
+// Only the counts can be repaired: the shape must already be the one
+// CFG::check expects.
+static
+bool repairable(CFG* cfg) {
+	if (!cfg->entryNode() || (!cfg->exitNode() && !cfg->haltNode()))
+		return false;
+
+	for (CfgNode* node : cfg->nodes()) {
+		unsigned preds = cfg->predecessors(node).size();
+		unsigned succs = cfg->successors(node).size();
+
+		switch (node->type()) {
+			case CfgNode::CFG_ENTRY:
+				if (preds != 0 || succs != 1 ||
+						CfgNode::node2addr(*cfg->successors(node).begin()) != cfg->addr())
+					return false;
+				break;
+			case CfgNode::CFG_BLOCK:
+				if (preds == 0 || succs == 0)
+					return false;
+				break;
+			case CfgNode::CFG_PHANTOM:
+			case CfgNode::CFG_EXIT:
+			case CfgNode::CFG_HALT:
+				if (preds == 0 || succs != 0)
+					return false;
+				break;
+			default:
+				assert(false);
+		}
+	}
+
+	return true;
+}
+
+bool FlowRepair::repair(CFG* cfg, unsigned long long& adjustment) {
+	adjustment = 0;
+	if (!repairable(cfg))
+		return false;
+
+	std::vector<CfgNode*> nodes(cfg->nodes().cbegin(), cfg->nodes().cend());
+	std::sort(nodes.begin(), nodes.end(), CfgNode::nodeOrder);
+
+	std::unordered_map<CfgNode*, unsigned> index(nodes.size());
+	for (unsigned i = 0; i < nodes.size(); i++)
+		index[nodes[i]] = i;
+
+	unsigned source = nodes.size();
+	unsigned sink = source + 1;
+	Network network(nodes.size() + 2);
+	std::vector<long long> balance(nodes.size(), 0);
+
+	unsigned entry = index[cfg->entryNode()];
+	std::vector<Adjustable> adjustables;
+	std::vector<CfgEdge*> phantoms;
+	for (unsigned u = 0; u < nodes.size(); u++) {
+		CfgNode* node = nodes[u];
+
+		std::vector<CfgNode*> succs(cfg->successors(node).cbegin(), cfg->successors(node).cend());
+		std::sort(succs.begin(), succs.end(), CfgNode::nodeOrder);
+		for (CfgNode* succ : succs) {
+			CfgEdge* edge = cfg->findEdge(node, succ);
+			assert(edge != 0);
+
+			// Self-loops leave the balance untouched: keep their counts.
+			if (succ == node)
+				continue;
+
+			// Phantom edges must carry nothing.
+			if (succ->type() == CfgNode::CFG_PHANTOM) {
+				phantoms.push_back(edge);
+				continue;
+			}
+
+			unsigned v = index[succ];
+			long long count = edge->count();
+			balance[v] += count;
+			balance[u] -= count;
+
+			Adjustable adjustable = { edge, u, v,
+				(int) network.addArc(u, v, Network::INFINITE, INCREASE_COST),
+				count > 0 ? (int) network.addArc(v, u, count, DECREASE_COST) : -1 };
+			adjustables.push_back(adjustable);
+		}
+
+		// The executions are free to follow whatever leaves through the
+		// exits, closing the flow back into the entry.
+		if (node->type() == CfgNode::CFG_EXIT || node->type() == CfgNode::CFG_HALT) {
+			long long leaving = 0;
+			for (CfgNode* pred : cfg->predecessors(node)) {
+				CfgEdge* edge = cfg->findEdge(pred, node);
+				assert(edge != 0);
+
+				leaving += edge->count();
+			}
+
+			balance[entry] += leaving;
+			balance[u] -= leaving;
+			network.addArc(u, entry, Network::INFINITE, 0);
+			if (leaving > 0)
+				network.addArc(entry, u, leaving, 0);
+		}
+	}
+
+	long long demand = 0;
+	for (unsigned v = 0; v < balance.size(); v++) {
+		if (balance[v] > 0) {
+			network.addArc(source, v, balance[v], 0);
+			demand += balance[v];
+		} else if (balance[v] < 0) {
+			network.addArc(v, sink, -balance[v], 0);
+		}
+	}
+
+	if (!network.solve(source, sink, demand))
+		return false;
+
+	for (CfgEdge* edge : phantoms) {
+		adjustment += edge->count();
+		edge->setCount(0);
+	}
+
+	for (const Adjustable& adjustable : adjustables) {
+		long long count = adjustable.edge->count();
+		long long increase = network.flow(adjustable.src, adjustable.increase);
+		long long decrease = 0;
+		if (adjustable.decrease >= 0)
+			decrease = network.flow(adjustable.dst, adjustable.decrease);
+
+		long long repaired = count + increase - decrease;
+		assert(repaired >= 0);
+
+		adjustment += (repaired > count ? repaired - count : count - repaired);
+		adjustable.edge->setCount(repaired);
+	}
+
+	CfgNode* first = *cfg->successors(cfg->entryNode()).begin();
+	cfg->setExecs(cfg->findEdge(cfg->entryNode(), first)->count());
+
+	if (cfg->check() != CFG::VALID)
+		return false;
+
+	cfg->setRepaired();
+	return true;
+}
+
+void FlowRepair::repair(const std::list<CFG*>& cfgs) {
+	std::vector<CFG*> invalid;
+	for (CFG* cfg : cfgs) {
+		if (cfg->status() == CFG::INVALID)
+			invalid.push_back(cfg);
+	}
+
+	m_results.resize(invalid.size());
+
+	ThreadPool pool(m_jobs);
+	for (std::vector<CFG*>::size_type i = 0; i < invalid.size(); i++) {
+		CFG* cfg = invalid[i];
+		Result& result = m_results[i];
+		pool.submit([cfg, &result] {
+			result.cfg = cfg;
+			result.repaired = FlowRepair::repair(cfg, result.adjustment);
+		});
+	}
+	pool.wait();
+}
+
+unsigned FlowRepair::repaired() const {
+	unsigned count = 0;
+	for (const Result& result : m_results) {
+		if (result.repaired)
+			count++;
+	}
+
+	return count;
+}
+
+unsigned long long FlowRepair::adjustment() const {
+	unsigned long long total = 0;
+	for (const Result& result : m_results)
+		total += result.adjustment;
+
+	return total;
+}
+
+std::string FlowRepair::str() const {
+	std::stringstream ss;
+
+	for (const Result& result : m_results) {
+		ss << std::hex << "[repair 0x" << result.cfg->addr() << " \""
+		   << result.cfg->functionName() << "\" " << std::dec;
+		if (result.repaired)
+			ss << "adjustment:" << result.adjustment;
+		else
+			ss << "failed";
+		ss << "]" << std::endl;
+	}
+
+	ss << "[repair repaired:" << this->repaired() << " failed:"
+	   << (m_results.size() - this->repaired())
+	   << " adjustment:" << this->adjustment() << "]" << std::endl;
+
+	return ss.str();
+}
@@ -0,0 +1,215 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#include <cassert>
+#include <sstream>
+#include <algorithm>
+#include <unordered_map>
+
+#include <CFG.h>
+#include <CfgNode.h>
+#include <ThreadPool.h>
+#include <FunctionOrder.h>
+
+FunctionOrder::FunctionOrder(const std::list<CFG*>& cfgs, unsigned jobs) {
+	std::vector<Arc> arcs;
+	this->build(cfgs, jobs, arcs);
+	this->cluster(arcs);
+}
+
+FunctionOrder::~FunctionOrder() {
+}
+
+struct CallArc {
+	CFG* callee;
+	unsigned long long count;
+};
+
+void FunctionOrder::build(const std::list<CFG*>& cfgs, unsigned jobs, std::vector<Arc>& arcs) {
+	std::vector<CFG*> all(cfgs.cbegin(), cfgs.cend());
+
+	m_functions.resize(all.size());
+	std::vector<std::vector<CallArc>> calls(all.size());
+
+	// Sizes, samples and calls of each CFG are independent.
+	ThreadPool pool(jobs);
+	for (std::vector<CFG*>::size_type i = 0; i < all.size(); i++) {
+		CFG* cfg = all[i];
+		Function& function = m_functions[i];
+		std::vector<CallArc>& call = calls[i];
+		pool.submit([cfg, &function, &call] {
+			function.cfg = cfg;
+			function.size = function.samples = 0;
+
+			for (CfgNode* node : cfg->nodes()) {
+				if (node->type() != CfgNode::CFG_BLOCK)
+					continue;
+
+				CfgNode::BlockData* data = static_cast<CfgNode::BlockData*>(node->data());
+				assert(data != 0);
+
+				unsigned long long count = cfg->blockCount(node);
+
+				function.size += data->size();
+				function.samples += count * data->instructions().size();
+
+				for (CfgCall* c : data->calls()) {
+					CallArc arc = { c->called(), c->count() };
+					call.push_back(arc);
+				}
+			}
+		});
+	}
+	pool.wait();
+
+	std::unordered_map<CFG*, unsigned> index;
+	index.reserve(all.size());
+	for (std::vector<CFG*>::size_type i = 0; i < all.size(); i++)
+		index[all[i]] = i;
+
+	// Calls to functions outside the selection are ignored.
+	for (std::vector<CFG*>::size_type i = 0; i < all.size(); i++) {
+		for (const CallArc& call : calls[i]) {
+			std::unordered_map<CFG*, unsigned>::const_iterator it = index.find(call.callee);
+			if (it == index.end() || it->second == i || call.count == 0)
+				continue;
+
+			Arc arc = { (unsigned) i, it->second, call.count };
+			arcs.push_back(arc);
+		}
+	}
+}
+
+void FunctionOrder::cluster(const std::vector<Arc>& arcs) {
+	unsigned size = m_functions.size();
+
+	// Heaviest caller of each function, the lowest address on ties.
+	std::vector<unsigned> pred(size, size);
+	std::vector<unsigned long long> predWeight(size, 0);
+	{
+		std::vector<Arc> sorted(arcs);
+		std::sort(sorted.begin(), sorted.end(), [](const Arc& a1, const Arc& a2) {
+			if (a1.callee != a2.callee)
+				return a1.callee < a2.callee;
+			return a1.caller < a2.caller;
+		});
+
+		for (std::vector<Arc>::size_type i = 0; i < sorted.size(); ) {
+			unsigned callee = sorted[i].callee;
+			unsigned caller = sorted[i].caller;
+			unsigned long long weight = 0;
+			for (; i < sorted.size() && sorted[i].callee == callee &&
+					sorted[i].caller == caller; i++)
+				weight += sorted[i].count;
+
+			if (weight > predWeight[callee]) {
+				pred[callee] = caller;
+				predWeight[callee] = weight;
+			}
+		}
+	}
+
+	// Clusters are linked lists of functions; their data lives in the
+	// union-find root.
+	std::vector<unsigned> parent(size), next(size, size), head(size), tail(size);
+	std::vector<unsigned long long> clusterSize(size), clusterSamples(size);
+	for (unsigned f = 0; f < size; f++) {
+		parent[f] = head[f] = tail[f] = f;
+		clusterSize[f] = std::max(m_functions[f].size, 1ULL);
+		clusterSamples[f] = m_functions[f].samples;
+	}
+
+	auto find = [&parent](unsigned f) {
+		while (parent[f] != f) {
+			parent[f] = parent[parent[f]];
+			f = parent[f];
+		}
+		return f;
+	};
+
+	auto density = [&clusterSize, &clusterSamples](unsigned c) {
+		return (double) clusterSamples[c] / clusterSize[c];
+	};
+
+	std::vector<unsigned> sorted;
+	for (unsigned f = 0; f < size; f++) {
+		if (m_functions[f].samples > 0)
+			sorted.push_back(f);
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [&density](unsigned f1, unsigned f2) {
+		return density(f1) > density(f2);
+	});
+
+	for (unsigned f : sorted) {
+		unsigned c = find(f);
+		if (pred[f] == size || clusterSize[c] > MAX_CLUSTER_SIZE)
+			continue;
+
+		unsigned p = find(pred[f]);
+		if (p == c || m_functions[pred[f]].samples == 0 ||
+				clusterSize[p] + clusterSize[c] > MAX_CLUSTER_SIZE)
+			continue;
+
+		double merged = (double) (clusterSamples[p] + clusterSamples[c]) /
+			(clusterSize[p] + clusterSize[c]);
+		if (density(p) > merged * MERGE_RATIO)
+			continue;
+
+		next[tail[p]] = head[c];
+		tail[p] = tail[c];
+		clusterSize[p] += clusterSize[c];
+		clusterSamples[p] += clusterSamples[c];
+		parent[c] = p;
+	}
+
+	std::vector<unsigned> clusters;
+	for (unsigned f : sorted) {
+		if (parent[f] == f)
+			clusters.push_back(f);
+	}
+	std::stable_sort(clusters.begin(), clusters.end(), [&density, &head](unsigned c1, unsigned c2) {
+		if (density(c1) != density(c2))
+			return density(c1) > density(c2);
+		return head[c1] < head[c2];
+	});
+
+	for (unsigned c : clusters) {
+		for (unsigned f = head[c]; f != size; f = next[f])
+			m_order.push_back(f);
+	}
+}
+
+std::string FunctionOrder::str() const {
+	std::stringstream ss;
+
+	// Unnamed functions keep their place as comments.
+	for (unsigned f : m_order) {
+		CFG* cfg = m_functions[f].cfg;
+		if (cfg->functionName() == "unknown" || cfg->functionName().empty())
+			ss << "# 0x" << std::hex << cfg->addr() << std::dec << std::endl;
+		else
+			ss << cfg->functionName() << std::endl;
+	}
+
+	return ss.str();
+}
@@ -0,0 +1,104 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#include <algorithm>
+
+#include <CFG.h>
+#include <CfgNode.h>
+#include <HotSubgraph.h>
+
+HotSubgraph::HotSubgraph(const CFG* cfg, double fraction, unsigned top) : m_cfg(cfg) {
+	std::vector<CfgNode*> nodes;
+	std::map<CfgNode*, unsigned long long> counts;
+	unsigned long long max = 0;
+	for (CfgNode* node : cfg->nodes()) {
+		if (node->type() != CfgNode::CFG_BLOCK && node->type() != CfgNode::CFG_PHANTOM)
+			continue;
+
+		unsigned long long count = cfg->blockCount(node);
+
+		nodes.push_back(node);
+		counts[node] = count;
+		max = std::max(max, count);
+	}
+	std::sort(nodes.begin(), nodes.end(), CfgNode::nodeOrder);
+
+	// Without executions, the hottest block stands for them.
+	double threshold = fraction * (cfg->execs() > 0 ? cfg->execs() : max);
+
+	std::vector<CfgNode*> ranked(nodes);
+	std::stable_sort(ranked.begin(), ranked.end(), [&counts](CfgNode* n1, CfgNode* n2) {
+		return counts[n1] > counts[n2];
+	});
+
+	std::map<CfgNode*, bool> hot;
+	for (std::vector<CfgNode*>::size_type i = 0; i < ranked.size(); i++) {
+		CfgNode* node = ranked[i];
+		hot[node] = node->type() == CfgNode::CFG_BLOCK &&
+			counts[node] > 0 &&
+			counts[node] >= threshold &&
+			(top == 0 || i < top);
+	}
+
+	// Cold regions are the connected components of the cold nodes,
+	// numbered in address order.
+	for (CfgNode* node : nodes) {
+		if (hot[node] || m_region.count(node))
+			continue;
+
+		Region region = { CfgNode::node2addr(node), CfgNode::node2addr(node), 0, 0 };
+		int id = m_regions.size();
+
+		std::vector<CfgNode*> stack(1, node);
+		m_region[node] = id;
+		while (!stack.empty()) {
+			CfgNode* current = stack.back();
+			stack.pop_back();
+
+			region.first = std::min(region.first, CfgNode::node2addr(current));
+			region.last = std::max(region.last, CfgNode::node2addr(current));
+			region.blocks++;
+			region.count += counts[current];
+
+			for (const std::set<CfgNode*>* adjacent : { &cfg->successors(current), &cfg->predecessors(current) }) {
+				for (CfgNode* next : *adjacent) {
+					if ((next->type() == CfgNode::CFG_BLOCK || next->type() == CfgNode::CFG_PHANTOM) &&
+							!hot[next] && !m_region.count(next)) {
+						m_region[next] = id;
+						stack.push_back(next);
+					}
+				}
+			}
+		}
+
+		m_regions.push_back(region);
+	}
+}
+
+HotSubgraph::~HotSubgraph() {
+}
+
+int HotSubgraph::region(CfgNode* node) const {
+	std::map<CfgNode*, int>::const_iterator it = m_region.find(node);
+	return it != m_region.end() ? it->second : -1;
+}
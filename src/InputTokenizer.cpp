@@ -22,7 +22,7 @@
 
 #include <InputTokenizer.h>
 
-InputTokenizer::InputTokenizer(std::fstream& input)
+InputTokenizer::InputTokenizer(std::istream& input)
 	: m_input(input) {
 	m_input >> std::noskipws;
 }
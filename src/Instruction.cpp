@@ -27,6 +27,7 @@
 #include <Instruction.h>
 
 std::map<Addr, Instruction*> Instruction::m_instrsMap;
+std::mutex Instruction::m_instrsMutex;
 
 Instruction::Instruction(Addr addr, int size, const std::string& text) :
 	m_addr(addr), m_size(size), m_text(text) {
@@ -36,6 +37,9 @@ Instruction::~Instruction() {
 }
 
 Instruction* Instruction::get(Addr addr, int size) {
+	// Blocks may be created concurrently by the readers.
+	std::lock_guard<std::mutex> lock(m_instrsMutex);
+
 	Instruction* instr = m_instrsMap[addr];
 	if (instr) {
 		if (instr->m_size == 0)
@@ -86,8 +90,25 @@ void Instruction::load(std::string filename) {
 }
 
 void Instruction::clear() {
+	std::lock_guard<std::mutex> lock(m_instrsMutex);
+
 	for (std::map<Addr, Instruction*>::iterator it = m_instrsMap.begin(),
 			ed = m_instrsMap.end(); it != ed; it++) {
 		delete it->second;
 	}
+	m_instrsMap.clear();
+}
+
+void Instruction::release() {
+	std::lock_guard<std::mutex> lock(m_instrsMutex);
+
+	std::map<Addr, Instruction*>::iterator it = m_instrsMap.begin();
+	while (it != m_instrsMap.end()) {
+		if (it->second->m_text == "???") {
+			delete it->second;
+			it = m_instrsMap.erase(it);
+		} else {
+			++it;
+		}
+	}
 }
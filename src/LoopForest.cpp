@@ -0,0 +1,264 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#include <cassert>
+#include <algorithm>
+
+#include <CFG.h>
+#include <CfgEdge.h>
+#include <CfgNode.h>
+#include <LoopForest.h>
+
+LoopForest::LoopForest(const CFG* cfg) : m_cfg(cfg) {
+	this->find();
+	this->measure();
+}
+
+LoopForest::~LoopForest() {
+	for (Loop* loop : m_loops)
+		delete loop;
+}
+
+static
+int findSet(std::vector<int>& parent, int x) {
+	while (parent[x] != x) {
+		parent[x] = parent[parent[x]];
+		x = parent[x];
+	}
+
+	return x;
+}
+
+void LoopForest::find() {
+	if (!m_cfg->entryNode())
+		return;
+
+	// Depth-first preorder numbering; last[w] is the number of the last
+	// descendant of w, so v descends from w iff w <= v <= last[w].
+	struct Frame {
+		CfgNode* node;
+		std::vector<CfgNode*> succs;
+		std::vector<CfgNode*>::size_type next;
+	};
+
+	std::vector<CfgNode*> nodes;
+	std::unordered_map<CfgNode*, int> number;
+	std::vector<int> last;
+	std::vector<Frame> stack;
+
+	auto visit = [&](CfgNode* node) {
+		number[node] = nodes.size();
+		nodes.push_back(node);
+		last.push_back(-1);
+
+		Frame frame;
+		frame.node = node;
+		const std::set<CfgNode*>& succs = m_cfg->successors(node);
+		frame.succs.assign(succs.cbegin(), succs.cend());
+		std::sort(frame.succs.begin(), frame.succs.end(), CfgNode::nodeOrder);
+		frame.next = 0;
+		stack.push_back(frame);
+	};
+
+	visit(m_cfg->entryNode());
+	while (!stack.empty()) {
+		Frame& frame = stack.back();
+		if (frame.next < frame.succs.size()) {
+			CfgNode* succ = frame.succs[frame.next++];
+			if (number.count(succ) == 0)
+				visit(succ);
+		} else {
+			last[number[frame.node]] = nodes.size() - 1;
+			stack.pop_back();
+		}
+	}
+
+	int size = nodes.size();
+	std::vector<std::vector<int>> backPreds(size), nonBackPreds(size);
+	std::vector<bool> selfLoop(size, false), irreducible(size, false);
+	std::vector<int> parent(size);
+	std::vector<Loop*> loopOf(size, (Loop*) 0);
+	// inPool[x] == w when x is in the pool of header w.
+	std::vector<int> inPool(size, -1);
+
+	for (int w = 0; w < size; w++) {
+		parent[w] = w;
+		for (CfgNode* pred : m_cfg->predecessors(nodes[w])) {
+			std::unordered_map<CfgNode*, int>::const_iterator it = number.find(pred);
+			if (it == number.end())
+				continue;
+
+			int v = it->second;
+			if (w <= v && v <= last[w])
+				backPreds[w].push_back(v);
+			else
+				nonBackPreds[w].push_back(v);
+		}
+	}
+
+	// Innermost loops are found first, visiting in reverse preorder.
+	for (int w = size - 1; w >= 0; w--) {
+		std::vector<int> pool;
+
+		for (int v : backPreds[w]) {
+			if (v != w)
+				pool.push_back(findSet(parent, v));
+			else
+				selfLoop[w] = true;
+		}
+
+		std::sort(pool.begin(), pool.end());
+		pool.erase(std::unique(pool.begin(), pool.end()), pool.end());
+		for (int x : pool)
+			inPool[x] = w;
+
+		std::vector<int> worklist(pool);
+		while (!worklist.empty()) {
+			int x = worklist.back();
+			worklist.pop_back();
+
+			for (int y : nonBackPreds[x]) {
+				int ydash = findSet(parent, y);
+				if (!(w <= ydash && ydash <= last[w])) {
+					irreducible[w] = true;
+					nonBackPreds[w].push_back(ydash);
+				} else if (ydash != w && inPool[ydash] != w) {
+					inPool[ydash] = w;
+					pool.push_back(ydash);
+					worklist.push_back(ydash);
+				}
+			}
+		}
+
+		if (pool.empty() && !selfLoop[w])
+			continue;
+
+		Loop* loop = new Loop();
+		loop->header = nodes[w];
+		loop->reducible = !irreducible[w];
+		loop->parent = 0;
+		loop->depth = 0;
+		loop->size = 0;
+		loop->entries = loop->backEdges = loop->weight = 0;
+		loop->blocks.push_back(nodes[w]);
+		loopOf[w] = loop;
+		m_loops.push_front(loop);
+
+		std::sort(pool.begin(), pool.end());
+		for (int x : pool) {
+			parent[x] = w;
+
+			if (loopOf[x]) {
+				loopOf[x]->parent = loop;
+				loop->children.push_back(loopOf[x]);
+			} else {
+				loop->blocks.push_back(nodes[x]);
+				loopOf[x] = loop;
+			}
+		}
+	}
+
+	for (int w = 0; w < size; w++) {
+		if (loopOf[w])
+			m_loopOf[nodes[w]] = loopOf[w];
+	}
+
+	// Loops were added innermost last, so parents precede their children.
+	for (Loop* loop : m_loops)
+		loop->depth = (loop->parent ? loop->parent->depth + 1 : 1);
+}
+
+LoopForest::Loop* LoopForest::loopOf(CfgNode* node) const {
+	std::unordered_map<CfgNode*, Loop*>::const_iterator it = m_loopOf.find(node);
+	return (it != m_loopOf.end() ? it->second : 0);
+}
+
+bool LoopForest::contains(const Loop* loop, CfgNode* node) const {
+	for (const Loop* l = this->loopOf(node); l != 0; l = l->parent) {
+		if (l == loop)
+			return true;
+	}
+
+	return false;
+}
+
+void LoopForest::measure() {
+	// Each edge enters the loops of its destination up to, and excluding,
+	// the innermost loop that also holds its source. The count is added
+	// at the destination loop and taken back at that common loop, so the
+	// bottom-up sums below credit exactly the loops in between.
+	std::unordered_map<Loop*, unsigned long long> entering, leaving;
+
+	for (const std::pair<CfgNode* const, Loop*>& entry : m_loopOf) {
+		CfgNode* node = entry.first;
+		Loop* loop = entry.second;
+
+		unsigned long long instrs = 1;
+		if (node->type() == CfgNode::CFG_BLOCK) {
+			CfgNode::BlockData* data = static_cast<CfgNode::BlockData*>(node->data());
+			if (!data->instructions().empty())
+				instrs = data->instructions().size();
+		}
+
+		for (CfgNode* pred : m_cfg->predecessors(node)) {
+			CfgEdge* edge = m_cfg->findEdge(pred, node);
+			assert(edge != 0);
+
+			// Innermost loop holding both ends, or 0.
+			Loop* common = loop;
+			Loop* other = this->loopOf(pred);
+			while (other && other->depth > common->depth)
+				other = other->parent;
+			while (common && common->depth > (other ? other->depth : 0))
+				common = common->parent;
+			while (common != other) {
+				common = common->parent;
+				other = other->parent;
+			}
+
+			if (common != loop) {
+				entering[loop] += edge->count();
+				if (common)
+					leaving[common] += edge->count();
+			} else if (node == loop->header) {
+				loop->backEdges += edge->count();
+			}
+		}
+
+		loop->weight += m_cfg->blockCount(node) * instrs;
+		loop->size++;
+	}
+
+	// Children follow their parents, so walking backwards sums bottom-up.
+	for (std::list<Loop*>::const_reverse_iterator it = m_loops.crbegin();
+			it != m_loops.crend(); ++it) {
+		Loop* loop = *it;
+		loop->entries += entering[loop] - leaving[loop];
+
+		if (loop->parent) {
+			loop->parent->size += loop->size;
+			loop->parent->weight += loop->weight;
+			loop->parent->entries += loop->entries;
+		}
+	}
+}
@@ -0,0 +1,69 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#include <string>
+#include <fstream>
+#include <sys/resource.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include <MemoryUsage.h>
+
+static
+unsigned long statusField(const std::string& field) {
+	std::ifstream input("/proc/self/status");
+	for (std::string line; getline(input, line); ) {
+		if (line.compare(0, field.length(), field) == 0 &&
+				line.length() > field.length() && line[field.length()] == ':')
+			return std::stoul(line.substr(field.length() + 1));
+	}
+
+	return 0;
+}
+
+unsigned long MemoryUsage::currentRSS() {
+	return statusField("VmRSS");
+}
+
+unsigned long MemoryUsage::peakRSS() {
+	unsigned long peak = statusField("VmHWM");
+	if (peak == 0) {
+		struct rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) == 0)
+			peak = usage.ru_maxrss;
+	}
+
+	return peak;
+}
+
+void MemoryUsage::resetPeak() {
+	std::ofstream output("/proc/self/clear_refs");
+	if (output.is_open())
+		output << "5";
+}
+
+void MemoryUsage::trim() {
+#ifdef __GLIBC__
+	malloc_trim(0);
+#endif
+}
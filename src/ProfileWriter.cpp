@@ -0,0 +1,197 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#include <set>
+#include <cassert>
+#include <sstream>
+#include <algorithm>
+
+#include <CFG.h>
+#include <CfgEdge.h>
+#include <CfgNode.h>
+#include <Instruction.h>
+#include <ThreadPool.h>
+#include <ProfileWriter.h>
+
+ProfileWriter::ProfileWriter(const std::list<CFG*>& cfgs, unsigned jobs)
+	: m_cfgs(cfgs.cbegin(), cfgs.cend()), m_jobs(jobs) {
+}
+
+ProfileWriter::~ProfileWriter() {
+}
+
+static
+std::vector<CfgNode*> sortedBlocks(const CFG* cfg) {
+	std::vector<CfgNode*> blocks;
+	for (CfgNode* node : cfg->nodes()) {
+		if (node->type() == CfgNode::CFG_BLOCK)
+			blocks.push_back(node);
+	}
+	std::sort(blocks.begin(), blocks.end(), CfgNode::nodeOrder);
+
+	return blocks;
+}
+
+static
+std::vector<CfgCall*> sortedCalls(CfgNode::BlockData* data) {
+	std::set<CfgCall*> tmp = data->calls();
+	std::vector<CfgCall*> calls(tmp.cbegin(), tmp.cend());
+	std::sort(calls.begin(), calls.end(), [](CfgCall* c1, CfgCall* c2) {
+		return c1->called()->addr() < c2->called()->addr();
+	});
+
+	return calls;
+}
+
+// Location of an fdata record: a symbol and an offset, or an absolute
+// address for unnamed functions.
+static
+std::string location(const CFG* cfg, Addr addr) {
+	std::stringstream ss;
+
+	ss << std::hex;
+	if (cfg->functionName() == "unknown")
+		ss << "0 [unknown] " << addr;
+	else
+		ss << "1 " << cfg->functionName() << " " << (addr - cfg->addr());
+
+	return ss.str();
+}
+
+static
+std::string fdata(const CFG* cfg) {
+	std::stringstream ss;
+
+	for (CfgNode* node : sortedBlocks(cfg)) {
+		CfgNode::BlockData* data = static_cast<CfgNode::BlockData*>(node->data());
+		assert(data != 0);
+
+		Instruction* last = data->lastInstruction();
+		std::string from = location(cfg, last != 0 ? last->addr() : data->addr());
+
+		std::vector<CfgNode*> succs;
+		for (CfgNode* succ : cfg->successors(node)) {
+			if (succ->type() == CfgNode::CFG_BLOCK)
+				succs.push_back(succ);
+		}
+		std::sort(succs.begin(), succs.end(), CfgNode::nodeOrder);
+
+		for (CfgNode* succ : succs) {
+			CfgEdge* edge = cfg->findEdge(node, succ);
+			assert(edge != 0);
+
+			Addr target = succ->data()->addr();
+			if (edge->count() == 0 || (cfg->successors(node).size() == 1 &&
+					target == data->addr() + data->size()))
+				continue;
+
+			ss << from << " " << location(cfg, target)
+			   << " 0 " << std::dec << edge->count() << std::endl;
+		}
+
+		std::vector<CfgCall*> calls = sortedCalls(data);
+
+		for (CfgCall* call : calls) {
+			if (call->count() == 0)
+				continue;
+
+			ss << from << " " << location(call->called(), call->called()->addr())
+			   << " 0 " << std::dec << call->count() << std::endl;
+		}
+	}
+
+	return ss.str();
+}
+
+static
+std::string sampleName(const CFG* cfg) {
+	if (cfg->functionName() != "unknown")
+		return cfg->functionName();
+
+	std::stringstream ss;
+	ss << std::hex << "0x" << cfg->addr();
+	return ss.str();
+}
+
+static
+std::string sampleProfile(const CFG* cfg) {
+	std::stringstream body;
+	unsigned long long total = 0;
+
+	for (CfgNode* node : sortedBlocks(cfg)) {
+		CfgNode::BlockData* data = static_cast<CfgNode::BlockData*>(node->data());
+		assert(data != 0);
+
+		unsigned long long count = cfg->blockCount(node);
+		if (count == 0)
+			continue;
+
+		total += count * data->instructions().size();
+		body << " " << std::dec << (data->addr() - cfg->addr()) << ": " << count;
+
+		std::vector<CfgCall*> calls = sortedCalls(data);
+
+		for (CfgCall* call : calls) {
+			if (call->count() > 0)
+				body << " " << sampleName(call->called()) << ":" << call->count();
+		}
+		body << std::endl;
+	}
+
+	if (total == 0)
+		return std::string();
+
+	std::stringstream ss;
+	ss << sampleName(cfg) << ":" << total << ":" << cfg->execs() << std::endl;
+	ss << body.str();
+
+	return ss.str();
+}
+
+std::string ProfileWriter::write(std::string (*writer)(const CFG*)) const {
+	std::vector<std::string> results(m_cfgs.size());
+
+	ThreadPool pool(m_jobs);
+	for (std::vector<CFG*>::size_type i = 0; i < m_cfgs.size(); i++) {
+		CFG* cfg = m_cfgs[i];
+		std::string& result = results[i];
+		pool.submit([cfg, &result, writer] {
+			result = writer(cfg);
+		});
+	}
+	pool.wait();
+
+	std::string output;
+	for (const std::string& result : results)
+		output += result;
+
+	return output;
+}
+
+std::string ProfileWriter::toFData() const {
+	return this->write(fdata);
+}
+
+std::string ProfileWriter::toSampleProfile() const {
+	return this->write(sampleProfile);
+}
@@ -0,0 +1,355 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+
+*/
+
+#include <map>
+#include <set>
+#include <cassert>
+#include <sstream>
+#include <unordered_map>
+
+#include <CFG.h>
+#include <CfgEdge.h>
+#include <CfgNode.h>
+#include <ThreadPool.h>
+#include <StaleMatcher.h>
+
+StaleMatcher::StaleMatcher(unsigned jobs) : m_jobs(jobs),
+		m_functions(0), m_byName(0), m_byHash(0), m_blocks(0),
+		m_matchedBlocks(0), m_count(0), m_carriedCount(0) {
+}
+
+StaleMatcher::~StaleMatcher() {
+	for (CFGHash* hash : m_profile)
+		delete hash;
+}
+
+// The hashes are cached by the CFGs, so only the ones that changed
+// since they were last hashed are computed again. The CFGs keep the
+// address order of CFGReader::cfgs().
+static
+std::vector<const CFGHash*> hashAll(const std::list<CFG*>& cfgs, unsigned jobs,
+		std::vector<CFG*>& all) {
+	all.assign(cfgs.cbegin(), cfgs.cend());
+
+	std::vector<const CFGHash*> hashes(all.size(), 0);
+
+	ThreadPool pool(jobs);
+	for (std::vector<CFG*>::size_type i = 0; i < all.size(); i++) {
+		CFG* cfg = all[i];
+		const CFGHash*& hash = hashes[i];
+		pool.submit([cfg, &hash] {
+			hash = &cfg->hash();
+		});
+	}
+	pool.wait();
+
+	return hashes;
+}
+
+void StaleMatcher::setProfile(const std::list<CFG*>& profile) {
+	for (CFGHash* hash : m_profile)
+		delete hash;
+
+	// Copied, as the profile CFGs drop their hashes once their
+	// instructions are released.
+	std::vector<CFG*> all;
+	std::vector<const CFGHash*> hashes = hashAll(profile, m_jobs, all);
+	m_profile.clear();
+	for (const CFGHash* hash : hashes)
+		m_profile.push_back(new CFGHash(*hash));
+
+	m_count = 0;
+	for (CFGHash* hash : m_profile) {
+		for (CfgEdge* edge : hash->cfg()->edges())
+			m_count += edge->count();
+	}
+}
+
+// Index of each key, or -1 when it is not unique.
+template <typename Key>
+static
+void uniqueIndex(std::unordered_map<Key, int>& index, const Key& key, int i) {
+	typename std::unordered_map<Key, int>::iterator it = index.find(key);
+	if (it == index.end())
+		index[key] = i;
+	else
+		it->second = -1;
+}
+
+template <typename Key>
+static
+int findUnique(const std::unordered_map<Key, int>& index, const Key& key) {
+	typename std::unordered_map<Key, int>::const_iterator it = index.find(key);
+	return (it != index.end() ? it->second : -1);
+}
+
+static
+void resetCounts(CFG* cfg) {
+	cfg->setExecs(0);
+	for (CfgEdge* edge : cfg->edges())
+		edge->setCount(0);
+
+	for (CfgNode* node : cfg->nodes()) {
+		if (node->type() != CfgNode::CFG_BLOCK)
+			continue;
+
+		CfgNode::BlockData* data = static_cast<CfgNode::BlockData*>(node->data());
+		assert(data != 0);
+
+		for (CfgCall* call : data->calls())
+			call->setCount(0);
+		for (CfgSignalHandler* handler : data->signalHandlers())
+			handler->setCount(0);
+	}
+}
+
+// Old block address to new block address.
+static
+std::map<Addr, Addr> matchBlocks(const CFGHash& before, const CFGHash& after) {
+	std::map<Addr, Addr> matches;
+	const std::vector<CFGHash::Block>& oldBlocks = before.blocks();
+	const std::vector<CFGHash::Block>& newBlocks = after.blocks();
+
+	std::unordered_map<CFGHash::Hash, int> oldShapes, newShapes;
+	for (unsigned i = 0; i < oldBlocks.size(); i++)
+		uniqueIndex(oldShapes, oldBlocks[i].shape, i);
+	for (unsigned i = 0; i < newBlocks.size(); i++)
+		uniqueIndex(newShapes, newBlocks[i].shape, i);
+
+	std::vector<bool> oldMatched(oldBlocks.size(), false);
+	std::vector<bool> newMatched(newBlocks.size(), false);
+	for (unsigned i = 0; i < newBlocks.size(); i++) {
+		if (findUnique(newShapes, newBlocks[i].shape) < 0)
+			continue;
+
+		int j = findUnique(oldShapes, newBlocks[i].shape);
+		if (j >= 0) {
+			matches[oldBlocks[j].addr] = newBlocks[i].addr;
+			oldMatched[j] = newMatched[i] = true;
+		}
+	}
+
+	// Same code but a different shape (e.g. a renamed callee): pair the
+	// occurrences of each opcode hash in address order.
+	std::map<CFGHash::Hash, std::list<unsigned>> oldOpcodes;
+	for (unsigned i = 0; i < oldBlocks.size(); i++) {
+		if (!oldMatched[i])
+			oldOpcodes[oldBlocks[i].opcodes].push_back(i);
+	}
+
+	for (unsigned i = 0; i < newBlocks.size(); i++) {
+		if (newMatched[i])
+			continue;
+
+		std::map<CFGHash::Hash, std::list<unsigned>>::iterator it =
+			oldOpcodes.find(newBlocks[i].opcodes);
+		if (it == oldOpcodes.end() || it->second.empty())
+			continue;
+
+		matches[oldBlocks[it->second.front()].addr] = newBlocks[i].addr;
+		it->second.pop_front();
+	}
+
+	return matches;
+}
+
+namespace {
+
+struct Result {
+	unsigned long long blocks;
+	unsigned long long matchedBlocks;
+	unsigned long long carriedCount;
+};
+
+}
+
+static
+void carryCounts(const CFGHash& before, CFG* after, const CFGHash& afterHash,
+		const std::unordered_map<const CFG*, CFG*>& functions, Result& result) {
+	const CFG* old = before.cfg();
+	std::map<Addr, Addr> blocks = matchBlocks(before, afterHash);
+	result.matchedBlocks = blocks.size();
+
+	std::map<CfgNode*, CfgNode*> nodes;
+	if (old->entryNode() && after->entryNode())
+		nodes[old->entryNode()] = after->entryNode();
+	if (old->exitNode() && after->exitNode())
+		nodes[old->exitNode()] = after->exitNode();
+	if (old->haltNode() && after->haltNode())
+		nodes[old->haltNode()] = after->haltNode();
+
+	for (const std::pair<const Addr, Addr>& match : blocks) {
+		CfgNode* src = old->nodeByAddr(match.first);
+		CfgNode* dst = after->nodeByAddr(match.second);
+		assert(src != 0 && dst != 0);
+
+		nodes[src] = dst;
+	}
+
+	for (CfgEdge* edge : old->edges()) {
+		std::map<CfgNode*, CfgNode*>::const_iterator src = nodes.find(edge->source());
+		std::map<CfgNode*, CfgNode*>::const_iterator dst = nodes.find(edge->destination());
+		if (src == nodes.end() || dst == nodes.end())
+			continue;
+
+		CfgEdge* target = after->findEdge(src->second, dst->second);
+		if (target != 0) {
+			target->updateCount(edge->count());
+			result.carriedCount += edge->count();
+		}
+	}
+
+	for (const std::pair<CfgNode* const, CfgNode*>& match : nodes) {
+		if (match.first->type() != CfgNode::CFG_BLOCK)
+			continue;
+
+		CfgNode::BlockData* src = static_cast<CfgNode::BlockData*>(match.first->data());
+		CfgNode::BlockData* dst = static_cast<CfgNode::BlockData*>(match.second->data());
+		assert(src != 0 && dst != 0);
+
+		std::set<CfgCall*> calls = dst->calls();
+		for (CfgCall* call : src->calls()) {
+			std::unordered_map<const CFG*, CFG*>::const_iterator it = functions.find(call->called());
+			if (it == functions.end())
+				continue;
+
+			for (CfgCall* target : calls) {
+				if (target->called() == it->second)
+					target->updateCount(call->count());
+			}
+		}
+
+		std::set<CfgSignalHandler*> handlers = dst->signalHandlers();
+		for (CfgSignalHandler* handler : src->signalHandlers()) {
+			std::unordered_map<const CFG*, CFG*>::const_iterator it = functions.find(handler->handler());
+			if (it == functions.end())
+				continue;
+
+			for (CfgSignalHandler* target : handlers) {
+				if (target->sigid() == handler->sigid() && target->handler() == it->second)
+					target->updateCount(handler->count());
+			}
+		}
+	}
+
+	after->setExecs(old->execs());
+}
+
+void StaleMatcher::match(const std::list<CFG*>& cfgs) {
+	std::vector<CFG*> all;
+	std::vector<const CFGHash*> current = hashAll(cfgs, m_jobs, all);
+	m_functions = current.size();
+	m_byName = m_byHash = 0;
+
+	std::unordered_map<std::string, int> oldNames, newNames;
+	for (unsigned i = 0; i < m_profile.size(); i++) {
+		if (m_profile[i]->cfg()->functionName() != "unknown")
+			uniqueIndex(oldNames, m_profile[i]->cfg()->functionName(), i);
+	}
+	for (unsigned i = 0; i < current.size(); i++) {
+		if (current[i]->cfg()->functionName() != "unknown")
+			uniqueIndex(newNames, current[i]->cfg()->functionName(), i);
+	}
+
+	std::vector<int> pairs(current.size(), -1);
+	std::vector<bool> used(m_profile.size(), false);
+	for (unsigned i = 0; i < current.size(); i++) {
+		const std::string& name = current[i]->cfg()->functionName();
+		if (name == "unknown" || findUnique(newNames, name) < 0)
+			continue;
+
+		int j = findUnique(oldNames, name);
+		if (j >= 0) {
+			pairs[i] = j;
+			used[j] = true;
+			m_byName++;
+		}
+	}
+
+	std::unordered_map<CFGHash::Hash, int> oldHashes, newHashes;
+	for (unsigned i = 0; i < m_profile.size(); i++) {
+		if (!used[i])
+			uniqueIndex(oldHashes, m_profile[i]->hash(), i);
+	}
+	for (unsigned i = 0; i < current.size(); i++) {
+		if (pairs[i] < 0)
+			uniqueIndex(newHashes, current[i]->hash(), i);
+	}
+
+	for (unsigned i = 0; i < current.size(); i++) {
+		if (pairs[i] >= 0 || findUnique(newHashes, current[i]->hash()) < 0)
+			continue;
+
+		int j = findUnique(oldHashes, current[i]->hash());
+		if (j >= 0) {
+			pairs[i] = j;
+			used[j] = true;
+			m_byHash++;
+		}
+	}
+
+	std::unordered_map<const CFG*, CFG*> functions;
+	for (unsigned i = 0; i < current.size(); i++) {
+		if (pairs[i] >= 0)
+			functions[m_profile[pairs[i]]->cfg()] = all[i];
+	}
+
+	// Each task only writes the counts of its own CFG.
+	std::vector<Result> results(current.size());
+	ThreadPool pool(m_jobs);
+	for (unsigned i = 0; i < current.size(); i++) {
+		Result& result = results[i];
+		result.blocks = current[i]->blocks().size();
+		result.matchedBlocks = result.carriedCount = 0;
+
+		CFG* cfg = all[i];
+		const CFGHash* before = (pairs[i] >= 0 ? m_profile[pairs[i]] : 0);
+		const CFGHash* after = current[i];
+		pool.submit([cfg, before, after, &functions, &result] {
+			resetCounts(cfg);
+			if (before != 0)
+				carryCounts(*before, cfg, *after, functions, result);
+			cfg->check();
+		});
+	}
+	pool.wait();
+
+	m_blocks = m_matchedBlocks = m_carriedCount = 0;
+	for (const Result& result : results) {
+		m_blocks += result.blocks;
+		m_matchedBlocks += result.matchedBlocks;
+		m_carriedCount += result.carriedCount;
+	}
+}
+
+std::string StaleMatcher::str() const {
+	std::stringstream ss;
+
+	ss << "[match functions:" << (m_byName + m_byHash) << "/" << m_functions
+	   << " by-name:" << m_byName
+	   << " by-hash:" << m_byHash
+	   << " blocks:" << m_matchedBlocks << "/" << m_blocks
+	   << " counts:" << m_carriedCount << "/" << m_count << "]" << std::endl;
+
+	return ss.str();
+}
@@ -0,0 +1,116 @@
+/*
+
+   Copyright (C) 2019, Andrei Rimsa (andrei@cefetmg.br)
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#include <ThreadPool.h>
+
+ThreadPool::ThreadPool(unsigned threads, unsigned maxPending)
+	: m_maxPending(maxPending), m_running(0), m_stop(false) {
+	if (threads == 0)
+		threads = ThreadPool::defaultThreads();
+
+	// With a single thread, tasks are executed by the caller on submit.
+	if (threads > 1) {
+		for (unsigned i = 0; i < threads; i++)
+			m_workers.push_back(std::thread(&ThreadPool::work, this));
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_taskReady.notify_all();
+
+	for (std::thread& worker : m_workers)
+		worker.join();
+}
+
+void ThreadPool::submit(const std::function<void()>& task) {
+	if (m_workers.empty()) {
+		task();
+		return;
+	}
+
+	{
+		// Block the producer while there are too many pending tasks.
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (m_maxPending > 0) {
+			m_taskTaken.wait(lock,
+				[this] { return m_tasks.size() < m_maxPending; });
+		}
+
+		m_tasks.push_back(task);
+	}
+	m_taskReady.notify_one();
+}
+
+void ThreadPool::wait() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_taskDone.wait(lock, [this] { return m_tasks.empty() && m_running == 0; });
+
+	// Propagate the first error raised by a task to the waiting thread.
+	if (m_error) {
+		std::exception_ptr error = m_error;
+		m_error = nullptr;
+		std::rethrow_exception(error);
+	}
+}
+
+unsigned ThreadPool::defaultThreads() {
+	unsigned threads = std::thread::hardware_concurrency();
+	return threads > 0 ? threads : 1;
+}
+
+void ThreadPool::work() {
+	while (true) {
+		std::function<void()> task;
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_taskReady.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+			if (m_tasks.empty())
+				return;
+
+			task = m_tasks.front();
+			m_tasks.pop_front();
+			m_running++;
+		}
+		m_taskTaken.notify_one();
+
+		std::exception_ptr error;
+		try {
+			task();
+		} catch (...) {
+			error = std::current_exception();
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			if (error && !m_error)
+				m_error = error;
+
+			m_running--;
+		}
+		m_taskDone.notify_all();
+	}
+}
@@ -23,6 +23,11 @@
 
 #include <iostream>
 #include <set>
+#include <map>
+#include <list>
+#include <vector>
+#include <cassert>
+#include <cstring>
 #include <string>
 #include <cstdlib>
 #include <iostream>
@@ -34,13 +39,31 @@
 #include <getopt.h>
 
 #include <CFG.h>
-#include <BFTraceReader.h>
-#include <CFGGrindReader.h>
-#include <DCFGReader.h>
+#include <CfgNode.h>
+#include <CFGDiff.h>
+#include <DominatorTree.h>
+#include <CFGStats.h>
+#include <CFGTop.h>
+#include <CFGInstrCounts.h>
+#include <CFGLoops.h>
+#include <CallGraph.h>
+#include <BlockLayout.h>
+#include <FunctionOrder.h>
+#include <ProfileWriter.h>
+#include <FlowRepair.h>
+#include <CFGIndirect.h>
+#include <StaleMatcher.h>
+#include <HotSubgraph.h>
+#include <ChainCompaction.h>
+#include <CFGLoader.h>
+#include <CFGReader.h>
+#include <CFGGrindMerger.h>
 #include <Instruction.h>
+#include <ThreadPool.h>
+#include <CFGGrindStream.h>
 
 struct Config {
-	enum {
+	enum Type {
 		UNDEF_TYPE,
 		BFTRACE_TYPE,
 		CFGGRIND_TYPE,
@@ -56,9 +79,40 @@ struct Config {
 	std::list<std::pair<Addr, Addr>> ranges;
 	char* instrs;
 	char* dump;
-	char* input;
+	unsigned jobs;
+	bool routines;
+	bool memory;
+	std::list<long> processes;
+	std::list<std::string> images;
+	std::list<std::pair<Type, std::string>> inputs;
+	bool stream;
+	unsigned long long budget;
+	const char* tmpdir;
+	bool diff;
+	bool stats;
+	unsigned top;
+	bool json;
+	bool instrCounts;
+	bool dominators;
+	bool loops;
+	const char* callGraph;
+	bool layout;
+	bool order;
+	const char* profile;
+	bool repair;
+	unsigned indirect;
+	bool match;
+	double hotFraction;
+	unsigned hotBlocks;
+	bool compact;
+	const char* chains;
+	char* newInstrs;
+	const char* expand;
 } config = { Config::UNDEF_TYPE, Config::SHOW_ALL,
-				std::list<std::pair<Addr, Addr>>(), 0, 0, 0 };
+				std::list<std::pair<Addr, Addr>>(), 0, 0, 0, false, false,
+				std::list<long>(), std::list<std::string>(),
+				std::list<std::pair<Config::Type, std::string>>(),
+				false, 0, 0, false, false, 0, false, false, false, false, 0, false, false, 0, false, 0, false, 0, 0, false, 0, 0, 0 };
 
 inline std::string& ltrim(std::string &s) {
 	s.erase(s.begin(), std::find_if(s.begin(), s.end(),
@@ -77,7 +131,7 @@ inline std::string& trim(std::string &s) {
 }
 
 void usage(char* progname) {
-	std::cout << "Usage: " << progname << " <Options> [CFG file]" << std::endl;
+	std::cout << "Usage: " << progname << " <Options> [[type:]CFG file]..." << std::endl;
 	std::cout << "Options:" << std::endl;
 	std::cout << "   -t   type        Input type" << std::endl;
 	std::cout << "                        bftrace: bftrace input format" << std::endl;
@@ -95,27 +149,131 @@ void usage(char* progname) {
 	std::cout << "                        can be used multiple times" << std::endl;
 	std::cout << "   -i   File        Instructions map (address:size:assembly per entry) file" << std::endl;
 	std::cout << "   -d   Directory   Dump DOT cfgs in directory" << std::endl;
+	std::cout << "   -j   Threads     Number of threads used to build the CFGs" << std::endl;
+	std::cout << "                        0: one per available core [default]" << std::endl;
+	std::cout << "   -R               Build one CFG per routine, in parallel (dcfg only)" << std::endl;
+	std::cout << "   -P   Pid         Convert only the given process (dcfg only)" << std::endl;
+	std::cout << "                        can be used multiple times" << std::endl;
+	std::cout << "   -I   Image       Convert only the given image file name (dcfg only)" << std::endl;
+	std::cout << "                        can be used multiple times" << std::endl;
+	std::cout << "   -m               Report the peak memory of each loading phase of a" << std::endl;
+	std::cout << "                        single CFG file: parse, build and check for dcfg," << std::endl;
+	std::cout << "                        build and check for cfggrind, build for bftrace" << std::endl;
+	std::cout << "   -S               Stream merge cfggrind files sorted by function address" << std::endl;
+	std::cout << "                        without building the CFGs" << std::endl;
+	std::cout << "   -B   Megabytes   Memory budget to convert out-of-core (cfggrind only)" << std::endl;
+	std::cout << "                        with -S, sort unsorted files in temporary runs" << std::endl;
+	std::cout << "   -T   Directory   Directory for temporary files [default: $TMPDIR or /tmp]" << std::endl;
+	std::cout << "   -D               Diff two CFG files (before and after), ranking the" << std::endl;
+	std::cout << "                        count changes by impact" << std::endl;
+	std::cout << "   --stats          Show only aggregate counts, without building the" << std::endl;
+	std::cout << "                        CFGs for bftrace and cfggrind files" << std::endl;
+	std::cout << "   -k   K           Report the K hottest functions, blocks and call sites" << std::endl;
+	std::cout << "   -c               Report dynamic instruction counts and mnemonic histogram" << std::endl;
+	std::cout << "   --json           Write the -k and -c reports in JSON" << std::endl;
+	std::cout << "   --dominators     Append the dominator and post-dominator trees" << std::endl;
+	std::cout << "                        of each CFG as [dom] and [pdom] records" << std::endl;
+	std::cout << "   --loops          Rank the loops of all CFGs by dynamic weight" << std::endl;
+	std::cout << "                        limited to the K heaviest with -k" << std::endl;
+	std::cout << "   --callgraph fmt  Write the call graph with inclusive counts" << std::endl;
+	std::cout << "                        text: call graph records" << std::endl;
+	std::cout << "                        dot: graphviz DOT" << std::endl;
+	std::cout << "                        callgrind: callgrind profile" << std::endl;
+	std::cout << "   --layout         Write a profile-guided block order of each CFG" << std::endl;
+	std::cout << "                        as [layout] records (hot blocks, cold blocks)" << std::endl;
+	std::cout << "   --order          Write a hot function order for the linker (C3/hfsort)" << std::endl;
+	std::cout << "                        as a symbol ordering file" << std::endl;
+	std::cout << "   --export fmt     Write the profile for post-link optimizers" << std::endl;
+	std::cout << "                        fdata: LLVM BOLT branch profile" << std::endl;
+	std::cout << "                        sample: LLVM sample profile (text)" << std::endl;
+	std::cout << "   --repair         Repair the counts of invalid CFGs with minimum-cost" << std::endl;
+	std::cout << "                        flow, reporting the adjustments to stderr and" << std::endl;
+	std::cout << "                        marking their cfg records as repaired" << std::endl;
+	std::cout << "   --indirect[=N]   Rank the indirect calls and jumps by the executions" << std::endl;
+	std::cout << "                        covered by their N top targets [default: 2]" << std::endl;
+	std::cout << "                        limited to the K most profitable with -k" << std::endl;
+	std::cout << "   --match          Carry the counts of a stale CFG file (first) over to" << std::endl;
+	std::cout << "                        the CFGs of a rebuilt binary (second), matching" << std::endl;
+	std::cout << "                        them by structural hashes; with --repair, fill" << std::endl;
+	std::cout << "                        in the counts that could not be matched; -i is" << std::endl;
+	std::cout << "                        given twice, for the stale and the rebuilt binary" << std::endl;
+	std::cout << "   --hot-fraction F Dump with -d only the blocks executed at least F" << std::endl;
+	std::cout << "                        times the CFG executions, collapsing the rest" << std::endl;
+	std::cout << "                        into cold region nodes" << std::endl;
+	std::cout << "   --hot-blocks N   Dump with -d only the N hottest blocks of each CFG," << std::endl;
+	std::cout << "                        collapsing the rest into cold region nodes" << std::endl;
+	std::cout << "   --compact[=file] Merge chains of fall-through blocks into superblocks" << std::endl;
+	std::cout << "                        writing the [chain] mapping to file" << std::endl;
+	std::cout << "   --expand file    Split the superblocks back into the chains of blocks" << std::endl;
+	std::cout << "                        recorded in the [chain] mapping file" << std::endl;
+	std::cout << std::endl;
+	std::cout << "Multiple CFG files are merged, adding up their counts. Each file" << std::endl;
+	std::cout << "may be prefixed by its type (e.g. cfggrind:run1.cfg) to override -t." << std::endl;
 	std::cout << std::endl;
 
 	exit(1);
 }
 
+Config::Type str2type(const char* str) {
+	if (strcasecmp(str, "bftrace") == 0)
+		return Config::BFTRACE_TYPE;
+	else if (strcasecmp(str, "cfggrind") == 0)
+		return Config::CFGGRIND_TYPE;
+	else if (strcasecmp(str, "dcfg") == 0)
+		return Config::DCFG_TYPE;
+	else
+		return Config::UNDEF_TYPE;
+}
+
+enum LongOption {
+	STATS_OPTION = 256,
+	JSON_OPTION,
+	DOMINATORS_OPTION,
+	LOOPS_OPTION,
+	CALLGRAPH_OPTION,
+	LAYOUT_OPTION,
+	ORDER_OPTION,
+	EXPORT_OPTION,
+	REPAIR_OPTION,
+	INDIRECT_OPTION,
+	MATCH_OPTION,
+	HOT_FRACTION_OPTION,
+	HOT_BLOCKS_OPTION,
+	COMPACT_OPTION,
+	EXPAND_OPTION
+};
+
+static struct option longOptions[] = {
+	{ "stats", no_argument, 0, STATS_OPTION },
+	{ "json", no_argument, 0, JSON_OPTION },
+	{ "dominators", no_argument, 0, DOMINATORS_OPTION },
+	{ "loops", no_argument, 0, LOOPS_OPTION },
+	{ "callgraph", required_argument, 0, CALLGRAPH_OPTION },
+	{ "layout", no_argument, 0, LAYOUT_OPTION },
+	{ "order", no_argument, 0, ORDER_OPTION },
+	{ "export", required_argument, 0, EXPORT_OPTION },
+	{ "repair", no_argument, 0, REPAIR_OPTION },
+	{ "indirect", optional_argument, 0, INDIRECT_OPTION },
+	{ "match", no_argument, 0, MATCH_OPTION },
+	{ "hot-fraction", required_argument, 0, HOT_FRACTION_OPTION },
+	{ "hot-blocks", required_argument, 0, HOT_BLOCKS_OPTION },
+	{ "compact", optional_argument, 0, COMPACT_OPTION },
+	{ "expand", required_argument, 0, EXPAND_OPTION },
+	{ 0, 0, 0, 0 }
+};
+
 void readoptions(int argc, char* argv[]) {
 	int opt;
 	char* idx;
 	Addr start, end;
 	std::ifstream input;
 
-	while ((opt = getopt(argc, argv, "t:s:r:a:A:i:d:")) != -1) {
+	while ((opt = getopt_long(argc, argv, "t:s:r:a:A:i:d:j:RP:I:mSB:T:Dk:c",
+			longOptions, 0)) != -1) {
 		switch (opt) {
 			case 't':
-				if (strcasecmp(optarg, "bftrace") == 0)
-					config.type = Config::BFTRACE_TYPE;
-				else if (strcasecmp(optarg, "cfggrind") == 0)
-					config.type = Config::CFGGRIND_TYPE;
-				else if (strcasecmp(optarg, "dcfg") == 0)
-					config.type = Config::DCFG_TYPE;
-				else
+				config.type = str2type(optarg);
+				if (config.type == Config::UNDEF_TYPE)
 					throw std::string("invalid type: ") + optarg;
 
 				break;
@@ -183,11 +341,112 @@ void readoptions(int argc, char* argv[]) {
 
 				break;
 			case 'i':
-				config.instrs = optarg;
+				if (config.instrs)
+					config.newInstrs = optarg;
+				else
+					config.instrs = optarg;
 				break;
 			case 'd':
 				config.dump = optarg;
 				break;
+			case 'j':
+				config.jobs = std::stoul(optarg);
+				break;
+			case 'R':
+				config.routines = true;
+				break;
+			case 'P':
+				config.processes.push_back(std::stol(optarg));
+				break;
+			case 'I':
+				config.images.push_back(optarg);
+				break;
+			case 'm':
+				config.memory = true;
+				break;
+			case 'S':
+				config.stream = true;
+				break;
+			case 'B':
+				config.budget = std::stoull(optarg) * 1024 * 1024;
+				if (config.budget == 0)
+					throw std::string("invalid budget: ") + optarg;
+
+				break;
+			case 'T':
+				config.tmpdir = optarg;
+				break;
+			case 'D':
+				config.diff = true;
+				break;
+			case STATS_OPTION:
+				config.stats = true;
+				break;
+			case 'k':
+				config.top = std::stoul(optarg);
+				if (config.top == 0)
+					throw std::string("invalid top: ") + optarg;
+
+				break;
+			case JSON_OPTION:
+				config.json = true;
+				break;
+			case 'c':
+				config.instrCounts = true;
+				break;
+			case DOMINATORS_OPTION:
+				config.dominators = true;
+				break;
+			case LOOPS_OPTION:
+				config.loops = true;
+				break;
+			case CALLGRAPH_OPTION:
+				if (strcasecmp(optarg, "text") != 0 && strcasecmp(optarg, "dot") != 0 &&
+						strcasecmp(optarg, "callgrind") != 0)
+					throw std::string("invalid call graph format: ") + optarg;
+
+				config.callGraph = optarg;
+				break;
+			case LAYOUT_OPTION:
+				config.layout = true;
+				break;
+			case ORDER_OPTION:
+				config.order = true;
+				break;
+			case EXPORT_OPTION:
+				if (strcasecmp(optarg, "fdata") != 0 && strcasecmp(optarg, "sample") != 0)
+					throw std::string("invalid export format: ") + optarg;
+
+				config.profile = optarg;
+				break;
+			case REPAIR_OPTION:
+				config.repair = true;
+				break;
+			case INDIRECT_OPTION:
+				config.indirect = (optarg ? std::stoul(optarg) : 2);
+				if (config.indirect == 0)
+					throw std::string("invalid number of indirect targets: ") + optarg;
+				break;
+			case MATCH_OPTION:
+				config.match = true;
+				break;
+			case HOT_FRACTION_OPTION:
+				config.hotFraction = std::stod(optarg);
+				if (config.hotFraction <= 0 || config.hotFraction > 1)
+					throw std::string("invalid hot fraction: ") + optarg;
+				break;
+			case HOT_BLOCKS_OPTION:
+				config.hotBlocks = std::stoul(optarg);
+				if (config.hotBlocks == 0)
+					throw std::string("invalid number of hot blocks: ") + optarg;
+				break;
+			case COMPACT_OPTION:
+				config.compact = true;
+				config.chains = optarg;
+				break;
+			case EXPAND_OPTION:
+				config.expand = optarg;
+				break;
 			default:
 				throw std::string("Invalid option: ") + (char) optopt;
 		}
@@ -196,13 +455,46 @@ void readoptions(int argc, char* argv[]) {
 	if (optind >= argc)
 		usage(argv[0]);
 
-	config.input = argv[optind++];
+	if (config.stream && config.type == Config::UNDEF_TYPE)
+		config.type = Config::CFGGRIND_TYPE;
+
+	for (; optind < argc; optind++) {
+		std::string input(argv[optind]);
+		Config::Type type = config.type;
+
+		std::string::size_type n = input.find(':');
+		if (n != std::string::npos) {
+			Config::Type prefix = str2type(input.substr(0, n).c_str());
+			if (prefix != Config::UNDEF_TYPE) {
+				type = prefix;
+				input = input.substr(n + 1);
+			}
+		}
+
+		if (type == Config::UNDEF_TYPE)
+			throw std::string("-t option is mandatory");
+
+		config.inputs.push_back(std::make_pair(type, input));
+	}
 
-	if (optind < argc)
-		throw std::string("Unknown extra option: ") + argv[optind];
+	// The inputs are loaded concurrently, while the peak memory is
+	// tracked for the whole process.
+	if (config.memory && config.inputs.size() > 1)
+		throw std::string("memory report (-m) requires a single CFG file");
 
-	if (config.type == Config::UNDEF_TYPE)
-		throw std::string("-t option is mandatory");
+	if (config.diff && config.inputs.size() != 2)
+		throw std::string("diff requires exactly two CFG files");
+
+	if (config.match) {
+		if (config.inputs.size() != 2)
+			throw std::string("match requires exactly two CFG files");
+
+		// One instruction map per binary: they are loaded in turn, as
+		// both binaries share the instructions by address.
+		if (config.instrs && !config.newInstrs)
+			throw std::string("match requires one instruction map per CFG file");
+	} else if (config.newInstrs)
+		throw std::string("only match takes two instruction maps");
 }
 
 bool isAddrInRange(Addr addr) {
@@ -219,60 +511,685 @@ bool isAddrInRange(Addr addr) {
 	return false;
 }
 
-int main(int argc, char* argv[]) {
+CFGReader* createReader(Config::Type type, const std::string& filename,
+		unsigned jobs) {
+	CFGLoader::Format format;
+	switch (type) {
+		case Config::BFTRACE_TYPE:
+			format = CFGLoader::BFTRACE_FORMAT;
+			break;
+		case Config::CFGGRIND_TYPE:
+			format = CFGLoader::CFGGRIND_FORMAT;
+			break;
+		case Config::DCFG_TYPE:
+			format = CFGLoader::DCFG_FORMAT;
+			break;
+		default:
+			assert(false);
+			return 0;
+	}
+
+	CFGLoader::Options options;
+	options.jobs = jobs;
+	options.routines = config.routines;
+	options.processes = config.processes;
+	options.images = config.images;
+
+	return CFGLoader::create(format, filename, options);
+}
+
+CFGReader* loadInputs() {
+	if (config.inputs.size() == 1) {
+		CFGReader* reader = createReader(config.inputs.front().first,
+			config.inputs.front().second, config.jobs);
+		try {
+			reader->setReportMemory(config.memory);
+			CFGLoader::load(reader);
+		} catch (...) {
+			delete reader;
+			throw;
+		}
+
+		return reader;
+	}
+
+	// Load the inputs in batches, one per thread, and merge each batch
+	// pairwise. Merging always into the leftmost reader keeps the result
+	// independent of the scheduling, and only a batch is kept in memory.
+	CFGReader* merged = 0;
+	ThreadPool pool(config.jobs);
+
+	std::list<std::pair<Config::Type, std::string>>::const_iterator it =
+		config.inputs.cbegin(), ed = config.inputs.cend();
+	while (it != ed) {
+		std::vector<CFGReader*> batch;
+		for (; it != ed && batch.size() < pool.threads(); ++it)
+			batch.push_back(createReader(it->first, it->second, 1));
+
+		for (CFGReader* reader : batch)
+			pool.submit([reader] { CFGLoader::load(reader); });
+		pool.wait();
+
+		for (std::vector<CFGReader*>::size_type step = 1; step < batch.size(); step *= 2) {
+			for (std::vector<CFGReader*>::size_type i = 0; i + step < batch.size(); i += 2 * step) {
+				CFGReader* dst = batch[i];
+				CFGReader* src = batch[i + step];
+				pool.submit([dst, src] { dst->merge(*src); delete src; });
+			}
+			pool.wait();
+		}
+
+		if (merged) {
+			merged->merge(*batch[0]);
+			delete batch[0];
+		} else {
+			merged = batch[0];
+		}
+	}
+
+	merged->setJobs(config.jobs);
+	merged->checkCFGs();
+
+	return merged;
+}
+
+void printCFG(CFG* cfg) {
+	if (!isAddrInRange(cfg->addr()))
+		return;
+
+	bool show;
+	switch (config.show) {
+		case Config::SHOW_ALL:
+			show = true;
+			break;
+		case Config::SHOW_VALID_ONLY:
+			show = cfg->status() == CFG::VALID;
+			break;
+		case Config::SHOW_INVALID_ONLY:
+			show = cfg->status() == CFG::INVALID;
+			break;
+		default:
+			assert(false);
+	}
+
+	if (show) {
+		std::cout << *cfg;
+
+		if (config.dominators) {
+			std::cout << cfg->dominatorTree().str();
+			std::cout << cfg->postDominatorTree().str();
+		}
+
+		if (config.dump) {
+			std::stringstream ss;
+			ss << config.dump << "/cfg-0x" << std::hex << cfg->addr() << ".dot";
+			if (config.hotFraction > 0 || config.hotBlocks > 0) {
+				HotSubgraph hot(cfg, config.hotFraction, config.hotBlocks);
+				cfg->dumpDOT(ss.str(), &hot);
+			} else {
+				cfg->dumpDOT(ss.str());
+			}
+		}
+	}
+}
+
+std::string tmpdir() {
+	if (config.tmpdir)
+		return config.tmpdir;
+
+	const char* env = getenv("TMPDIR");
+	return (env && *env ? env : "/tmp");
+}
+
+void streamInputs() {
+	std::list<std::string> files;
+	for (const std::pair<Config::Type, std::string>& input : config.inputs) {
+		if (input.first != Config::CFGGRIND_TYPE)
+			throw std::string("only cfggrind files can be stream merged: ") + input.second;
+
+		files.push_back(input.second);
+	}
+
+	// Without runs an input may turn out unsorted halfway, so merge into
+	// a temporary file and only copy it out once the merge succeeded.
+	if (config.budget == 0) {
+		std::string tmp = CFGGrindMerger::tempFile(tmpdir());
+		try {
+			std::ofstream output(tmp);
+			if (!output.is_open())
+				throw std::string("Unable to write file: ") + tmp;
+
+			CFGGrindMerger::merge(files, output, tmpdir(), isAddrInRange);
+			output.close();
+
+			std::ifstream input(tmp);
+			if (!input.is_open())
+				throw std::string("Unable to open file: ") + tmp;
+
+			if (input.peek() != std::ifstream::traits_type::eof())
+				std::cout << input.rdbuf();
+		} catch (...) {
+			std::remove(tmp.c_str());
+			throw;
+		}
+		std::remove(tmp.c_str());
+
+		return;
+	}
+
+	std::list<std::string> runs;
+	try {
+		for (const std::string& file : files)
+			runs.splice(runs.end(), CFGGrindMerger::sortRuns(file, config.budget, tmpdir()));
+
+		CFGGrindMerger::merge(runs, std::cout, tmpdir(), isAddrInRange);
+	} catch (...) {
+		CFGGrindMerger::removeFiles(runs);
+		throw;
+	}
+
+	CFGGrindMerger::removeFiles(runs);
+}
+
+// Build, check and print the CFGs of a batch of functions, loading the
+// records of each input separately and merging them as loadInputs does.
+void convertBatch(std::vector<std::vector<CFGGrindStream::Record>>& batch,
+		Addr first, Addr last) {
+	CFGReader* merged = 0;
+	unsigned loaded = 0;
+
+	for (std::vector<CFGGrindStream::Record>& records : batch) {
+		if (records.empty())
+			continue;
+
+		std::string tmp = CFGGrindMerger::tempFile(tmpdir());
+		CFGReader* reader = 0;
+		try {
+			std::ofstream out(tmp);
+			if (!out.is_open())
+				throw std::string("Unable to write file: ") + tmp;
+
+			for (const CFGGrindStream::Record& record : records)
+				CFGGrindStream::write(out, record);
+			out.close();
+			records.clear();
+
+			reader = createReader(Config::CFGGRIND_TYPE, tmp, config.jobs);
+			CFGLoader::load(reader);
+		} catch (...) {
+			delete reader;
+			delete merged;
+			std::remove(tmp.c_str());
+			throw;
+		}
+		std::remove(tmp.c_str());
+
+		if (merged) {
+			merged->merge(*reader);
+			delete reader;
+		} else {
+			merged = reader;
+		}
+		loaded++;
+	}
+
+	if (!merged)
+		return;
+
+	if (loaded > 1)
+		merged->checkCFGs();
+
+	// Referenced functions outside the batch are printed by their own batch.
+	for (CFG* cfg : merged->cfgs()) {
+		if (cfg->addr() >= first && cfg->addr() <= last)
+			printCFG(cfg);
+	}
+
+	delete merged;
+	Instruction::release();
+}
+
+// Spill the inputs in runs sorted by function address, then convert
+// contiguous batches of functions that fit in half of the budget.
+void convertOutOfCore() {
+	std::list<std::string> runs;
+	std::vector<unsigned> sources;
+
+	try {
+		unsigned idx = 0;
+		for (const std::pair<Config::Type, std::string>& input : config.inputs) {
+			if (input.first != Config::CFGGRIND_TYPE)
+				throw std::string("only cfggrind files can be converted out-of-core: ") + input.second;
+
+			std::list<std::string> tmp = CFGGrindMerger::sortRuns(input.second,
+				config.budget, tmpdir(), true);
+			sources.insert(sources.end(), tmp.size(), idx++);
+			runs.splice(runs.end(), tmp);
+		}
+
+		CFGGrindMerger merger(runs);
+		std::vector<std::vector<CFGGrindStream::Record>> batch(config.inputs.size());
+		unsigned long long used = 0;
+		Addr first = 0, last = 0;
+
+		CFGGrindMerger::Group group;
+		while (merger.nextGroup(group)) {
+			if (used == 0)
+				first = group.front().second.faddr;
+			last = group.front().second.faddr;
+
+			bool defined = false;
+			for (const std::pair<unsigned, CFGGrindStream::Record>& entry : group) {
+				if (entry.second.type == CFGGrindStream::Record::REF_RECORD)
+					continue;
+
+				batch[sources[entry.first]].push_back(entry.second);
+				used += CFGGrindMerger::recordSize(entry.second);
+				defined = true;
+			}
+
+			// Functions only referenced are created with an empty record.
+			if (!defined) {
+				CFGGrindStream::Record stub;
+				stub.type = CFGGrindStream::Record::CFG_RECORD;
+				stub.faddr = last;
+				stub.execs = 0;
+				stub.name = "unknown";
+				stub.complete = false;
+				stub.repaired = false;
+
+				batch[sources[group.front().first]].push_back(stub);
+				used += CFGGrindMerger::recordSize(stub);
+			}
+
+			if (used >= config.budget / 2) {
+				convertBatch(batch, first, last);
+				used = 0;
+			}
+		}
+
+		if (used > 0)
+			convertBatch(batch, first, last);
+	} catch (...) {
+		CFGGrindMerger::removeFiles(runs);
+		throw;
+	}
+
+	CFGGrindMerger::removeFiles(runs);
+}
+
+void diffInputs() {
+	std::vector<CFGReader*> readers;
+	try {
+		ThreadPool pool(config.jobs);
+		unsigned jobs = std::max(pool.threads() / 2, 1u);
+		for (const std::pair<Config::Type, std::string>& input : config.inputs)
+			readers.push_back(createReader(input.first, input.second, jobs));
+
+		for (CFGReader* reader : readers)
+			pool.submit([reader] { CFGLoader::load(reader); });
+		pool.wait();
+
+		CFGDiff diff(config.jobs);
+		diff.compare(*readers[0], *readers[1], isAddrInRange);
+		std::cout << diff;
+	} catch (...) {
+		for (CFGReader* reader : readers)
+			delete reader;
+		throw;
+	}
+
+	for (CFGReader* reader : readers)
+		delete reader;
+}
+
+void matchInputs() {
+	CFGReader* profile = createReader(config.inputs.front().first,
+		config.inputs.front().second, config.jobs);
 	CFGReader* reader = 0;
+
 	try {
-		readoptions(argc, argv);
+		CFGLoader::load(profile);
 
-		if (config.instrs)
-			Instruction::load(std::string(config.instrs));
+		StaleMatcher matcher(config.jobs);
+		matcher.setProfile(profile->cfgs());
 
-		switch (config.type) {
-			case Config::BFTRACE_TYPE:
-				reader = new BFTraceReader(config.input);
-				break;
+		// The old instructions are hashed; release them so the new
+		// binary may place different ones at the same addresses.
+		for (CFG* cfg : profile->cfgs()) {
+			for (CfgNode* node : cfg->nodes()) {
+				if (node->type() == CfgNode::CFG_BLOCK)
+					static_cast<CfgNode::BlockData*>(node->data())->clearInstructions();
+			}
+			cfg->invalidate();
+		}
+
+		if (config.newInstrs) {
+			Instruction::clear();
+			Instruction::load(std::string(config.newInstrs));
+		} else {
+			Instruction::release();
+		}
+
+		reader = createReader(config.inputs.back().first,
+			config.inputs.back().second, config.jobs);
+		CFGLoader::load(reader);
+
+		matcher.match(reader->cfgs());
+		std::cerr << matcher.str();
+
+		if (config.repair) {
+			FlowRepair repair(config.jobs);
+			repair.repair(reader->cfgs());
+			std::cerr << repair.str();
+		}
+
+		for (CFG* cfg : reader->cfgs())
+			printCFG(cfg);
+	} catch (...) {
+		delete profile;
+		if (reader)
+			delete reader;
+		throw;
+	}
+
+	delete profile;
+	delete reader;
+}
+
+void compactCFGs(CFGReader* reader) {
+	std::vector<CFG*> cfgs;
+	for (CFG* cfg : reader->cfgs()) {
+		if (isAddrInRange(cfg->addr()))
+			cfgs.push_back(cfg);
+	}
+
+	std::vector<ChainCompaction*> results(cfgs.size(), 0);
+
+	ThreadPool pool(config.jobs);
+	for (std::vector<CFG*>::size_type i = 0; i < cfgs.size(); i++) {
+		CFG* cfg = cfgs[i];
+		ChainCompaction*& result = results[i];
+		pool.submit([cfg, &result] {
+			result = new ChainCompaction(cfg);
+		});
+	}
+	pool.wait();
+
+	unsigned long long chains = 0, blocks = 0, compacted = 0;
+	std::ofstream output;
+	if (config.chains) {
+		output.open(config.chains);
+		if (!output.is_open())
+			throw std::string("Unable to write file: ") + config.chains;
+	}
+
+	for (ChainCompaction* result : results) {
+		chains += result->chains().size();
+		blocks += result->blocks();
+		compacted += result->compacted();
+
+		if (output.is_open())
+			output << result->str();
+
+		delete result;
+	}
+
+	std::cerr << "[compact chains:" << chains << " blocks:" << blocks
+	          << "->" << compacted << "]" << std::endl;
+}
+
+void expandCFGs(CFGReader* reader) {
+	std::ifstream input(config.expand);
+	if (!input.is_open())
+		throw std::string("Unable to open file: ") + config.expand;
+
+	std::map<Addr, std::vector<ChainCompaction::Chain>> chains =
+		ChainCompaction::read(input, *reader);
+
+	std::vector<ChainCompaction*> results;
+	try {
+		for (const std::pair<const Addr, std::vector<ChainCompaction::Chain>>& entry : chains) {
+			CFG* cfg = reader->cfg(entry.first);
+			if (cfg == 0) {
+				std::stringstream ss;
+				ss << std::hex << "Unknown function in chain mapping: 0x" << entry.first;
+				throw ss.str();
+			}
+
+			results.push_back(new ChainCompaction(cfg, entry.second));
+		}
+	} catch (...) {
+		for (ChainCompaction* result : results)
+			delete result;
+		throw;
+	}
+
+	unsigned long long count = 0, blocks = 0, compacted = 0;
+	for (ChainCompaction* result : results) {
+		count += result->chains().size();
+		blocks += result->blocks();
+		compacted += result->compacted();
+	}
+
+	// The CFGs without chains keep their blocks, as in compactCFGs.
+	for (CFG* cfg : reader->cfgs()) {
+		if (!isAddrInRange(cfg->addr()) || chains.count(cfg->addr()) > 0)
+			continue;
+
+		for (CfgNode* node : cfg->nodes()) {
+			if (node->type() == CfgNode::CFG_BLOCK) {
+				blocks++;
+				compacted++;
+			}
+		}
+	}
+
+	ThreadPool pool(config.jobs);
+	for (ChainCompaction* result : results)
+		pool.submit([result] { result->expand(); });
+	pool.wait();
+
+	for (ChainCompaction* result : results)
+		delete result;
+
+	std::cerr << "[expand chains:" << count << " blocks:" << compacted
+	          << "->" << blocks << "]" << std::endl;
+}
+
+void showStats() {
+	for (const std::pair<Config::Type, std::string>& input : config.inputs) {
+		CFGStats stats;
+		switch (input.first) {
 			case Config::CFGGRIND_TYPE:
-				reader = new CFGGrindReader(config.input);
+				stats.loadCFGGrind(input.second);
 				break;
-			case Config::DCFG_TYPE:
-				reader = new DCFGReader(config.input);
+			case Config::BFTRACE_TYPE:
+				stats.loadBFTrace(input.second);
+				break;
+			default: {
+				CFGReader* reader = createReader(input.first, input.second, config.jobs);
+				try {
+					CFGLoader::load(reader);
+					for (CFG* cfg : reader->cfgs())
+						stats.add(cfg);
+				} catch (...) {
+					delete reader;
+					throw;
+				}
+				delete reader;
+				}
 				break;
-			default:
-				assert(false);
 		}
 
-		reader->loadCFGs();
-		for (CFG* cfg : reader->cfgs()) {
-			if (!isAddrInRange(cfg->addr()))
-				continue;
-
-			bool show;
-			switch (config.show) {
-				case Config::SHOW_ALL:
-					show = true;
-					break;
-				case Config::SHOW_VALID_ONLY:
-					show = cfg->status() == CFG::VALID;
-					break;
-				case Config::SHOW_INVALID_ONLY:
-					show = cfg->status() == CFG::INVALID;
-					break;
-				default:
-					assert(false);
+		if (config.inputs.size() > 1)
+			std::cout << "[" << input.second << "]" << std::endl;
+
+		std::cout << stats;
+	}
+}
+
+void layoutCFGs(CFGReader* reader) {
+	std::vector<CFG*> cfgs;
+	for (CFG* cfg : reader->cfgs()) {
+		if (isAddrInRange(cfg->addr()))
+			cfgs.push_back(cfg);
+	}
+
+	std::vector<std::string> results(cfgs.size());
+
+	ThreadPool pool(config.jobs);
+	for (std::vector<CFG*>::size_type i = 0; i < cfgs.size(); i++) {
+		CFG* cfg = cfgs[i];
+		std::string& result = results[i];
+		pool.submit([cfg, &result] {
+			BlockLayout layout(cfg);
+			result = layout.str();
+		});
+	}
+	pool.wait();
+
+	for (const std::string& result : results)
+		std::cout << result;
+}
+
+int main(int argc, char* argv[]) {
+	CFGReader* reader = 0;
+	int status = EXIT_SUCCESS;
+	try {
+		readoptions(argc, argv);
+
+		if (config.stream) {
+			streamInputs();
+			return 0;
+		}
+
+		if (config.instrs)
+			Instruction::load(std::string(config.instrs));
+
+		if (config.stats) {
+			showStats();
+		} else if (config.diff) {
+			diffInputs();
+		} else if (config.match) {
+			matchInputs();
+		} else if (config.budget > 0) {
+			convertOutOfCore();
+		} else {
+			reader = loadInputs();
+			if (config.expand)
+				expandCFGs(reader);
+
+			if (config.repair) {
+				std::list<CFG*> cfgs;
+				for (CFG* cfg : reader->cfgs()) {
+					if (isAddrInRange(cfg->addr()))
+						cfgs.push_back(cfg);
+				}
+
+				FlowRepair repair(config.jobs);
+				repair.repair(cfgs);
+				std::cerr << repair.str();
 			}
 
-			if (show) {
-				std::cout << *cfg;
+			if (config.compact)
+				compactCFGs(reader);
 
-				if (config.dump) {
-					std::stringstream ss;
-					ss << config.dump << "/cfg-0x" << std::hex << cfg->addr() << ".dot";
-					cfg->dumpDOT(ss.str());
+			if (config.callGraph) {
+				std::list<CFG*> cfgs;
+				for (CFG* cfg : reader->cfgs()) {
+					if (isAddrInRange(cfg->addr()))
+						cfgs.push_back(cfg);
+				}
+
+				CallGraph graph(cfgs, config.jobs);
+				if (strcasecmp(config.callGraph, "dot") == 0)
+					std::cout << graph.toDOT();
+				else if (strcasecmp(config.callGraph, "callgrind") == 0)
+					std::cout << graph.toCallgrind();
+				else
+					std::cout << graph.str();
+			} else if (config.indirect > 0) {
+				std::list<CFG*> cfgs;
+				for (CFG* cfg : reader->cfgs()) {
+					if (isAddrInRange(cfg->addr()))
+						cfgs.push_back(cfg);
+				}
+
+				CFGIndirect indirect(config.indirect, config.jobs);
+				indirect.rank(cfgs, config.top);
+
+				if (config.json)
+					std::cout << indirect.toJSON() << std::endl;
+				else
+					std::cout << indirect.str();
+			} else if (config.profile) {
+				std::list<CFG*> cfgs;
+				for (CFG* cfg : reader->cfgs()) {
+					if (isAddrInRange(cfg->addr()))
+						cfgs.push_back(cfg);
+				}
+
+				ProfileWriter writer(cfgs, config.jobs);
+				if (strcasecmp(config.profile, "fdata") == 0)
+					std::cout << writer.toFData();
+				else
+					std::cout << writer.toSampleProfile();
+			} else if (config.order) {
+				std::list<CFG*> cfgs;
+				for (CFG* cfg : reader->cfgs()) {
+					if (isAddrInRange(cfg->addr()))
+						cfgs.push_back(cfg);
 				}
+
+				FunctionOrder order(cfgs, config.jobs);
+				std::cout << order.str();
+			} else if (config.layout) {
+				layoutCFGs(reader);
+			} else if (config.loops) {
+				std::list<CFG*> cfgs;
+				for (CFG* cfg : reader->cfgs()) {
+					if (isAddrInRange(cfg->addr()))
+						cfgs.push_back(cfg);
+				}
+
+				CFGLoops loops(config.jobs);
+				loops.rank(cfgs, config.top);
+
+				if (config.json)
+					std::cout << loops.toJSON() << std::endl;
+				else
+					std::cout << loops.str();
+			} else if (config.top > 0) {
+				CFGTop top(config.top);
+				for (CFG* cfg : reader->cfgs()) {
+					if (isAddrInRange(cfg->addr()))
+						top.add(cfg);
+				}
+
+				if (config.json)
+					std::cout << top.toJSON() << std::endl;
+				else
+					std::cout << top.str();
+			} else if (config.instrCounts) {
+				CFGInstrCounts counts;
+				for (CFG* cfg : reader->cfgs()) {
+					if (isAddrInRange(cfg->addr()))
+						counts.add(cfg);
+				}
+
+				if (config.json)
+					std::cout << counts.toJSON() << std::endl;
+				else
+					std::cout << counts.str();
+			} else {
+				for (CFG* cfg : reader->cfgs())
+					printCFG(cfg);
 			}
 		}
 	} catch (const std::string& str) {
 		std::cerr << "error: " << str << std::endl;
+		status = EXIT_FAILURE;
 	}
 
 	if (reader != 0)
@@ -281,5 +1198,5 @@ int main(int argc, char* argv[]) {
 	if (config.instrs)
 		Instruction::clear();
 
-	return 0;
+	return status;
 }